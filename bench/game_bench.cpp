@@ -0,0 +1,422 @@
+// Benchmarks for the main parts of the game, each run at a range of sizes
+// so that it's clear how they scale. Content is generated from a fixed
+// seed, so every run measures exactly the same work, and any files needed
+// are written to the working directory and removed again afterwards.
+//
+// Each result is written to stdout as a single line of JSON, giving the
+// time per operation in nanoseconds (the mean, median, 99th percentile and
+// fastest over all the samples) and the throughput, so results from
+// different builds can be compared by a script. Progress goes to stderr.
+//
+// Usage: game_bench.out [--quick] [filter]
+//   --quick   fewer samples and only the smaller sizes
+//   filter    only run benchmarks whose name contains it
+#include <iostream>
+#include <sstream>
+#include <string>
+#include <vector>
+#include <memory>
+#include <algorithm>
+#include <functional>
+#include <chrono>
+#include <random>
+#include <cstdio>
+#include <cstdlib>
+#include <JsonBox.h>
+
+#include "../src/item.hpp"
+#include "../src/weapon.hpp"
+#include "../src/armor.hpp"
+#include "../src/creature.hpp"
+#include "../src/door.hpp"
+#include "../src/area.hpp"
+#include "../src/player.hpp"
+#include "../src/battle.hpp"
+#include "../src/inventory.hpp"
+#include "../src/dialogue.hpp"
+#include "../src/save_data.hpp"
+#include "../src/save_writer.hpp"
+#include "../src/entity_manager.hpp"
+#include "../src/world_overlay.hpp"
+
+const unsigned int seed = 20240601;
+
+bool quick = false;
+std::string filter;
+
+// Total number of operations aimed for in each sample, so that the large
+// sizes don't take forever
+const unsigned long long workPerSample = 100000;
+
+// Operations per sample for something whose cost grows with n
+unsigned int opsFor(unsigned long long n)
+{
+	unsigned long long ops = workPerSample / n;
+	if(ops < 1) ops = 1;
+	if(ops > 1000) ops = 1000;
+
+	return ops;
+}
+
+// Time samples of body, calling setup before each one without timing it,
+// and write out the result. Each sample does ops operations
+void run(const std::string& name, unsigned long long n, unsigned int ops,
+	std::function<void()> setup, std::function<void()> body)
+{
+	if(name.find(filter) == std::string::npos) return;
+
+	unsigned int samples = quick ? 5 : 30;
+	std::vector<double> times;
+	for(unsigned int i = 0; i < samples; ++i)
+	{
+		setup();
+		auto start = std::chrono::steady_clock::now();
+		body();
+		auto end = std::chrono::steady_clock::now();
+		times.push_back(std::chrono::duration<double, std::nano>(end - start).count() / ops);
+	}
+
+	std::sort(times.begin(), times.end());
+	double mean = 0;
+	for(auto t : times) mean += t;
+	mean /= times.size();
+	double p50 = times[times.size() / 2];
+	double p99 = times[std::min(times.size() - 1, std::size_t(times.size() * 0.99))];
+
+	std::printf("{\"benchmark\": \"%s\", \"n\": %llu, \"ops\": %u, \"samples\": %u, "
+		"\"mean_ns\": %.1f, \"p50_ns\": %.1f, \"p99_ns\": %.1f, \"min_ns\": %.1f, "
+		"\"ops_per_sec\": %.1f}\n",
+		name.c_str(), n, ops, samples, mean, p50, p99, times[0], 1e9 / mean);
+	std::fflush(stdout);
+	std::cerr << name << " n=" << n << " done" << std::endl;
+
+	return;
+}
+
+// Sizes to run at, leaving out the largest when running quickly
+std::vector<unsigned long long> sizes(std::vector<unsigned long long> all)
+{
+	if(quick && all.size() > 2) all.resize(all.size() - 1);
+
+	return all;
+}
+
+std::string itemId(unsigned long long i)
+{
+	return "item_" + std::to_string(i);
+}
+
+std::string areaId(unsigned long long i)
+{
+	return "area_" + std::to_string(i);
+}
+
+// Write n items to the file
+void writeItems(const std::string& filename, unsigned long long n)
+{
+	JsonBox::Object o;
+	for(unsigned long long i = 0; i < n; ++i)
+	{
+		JsonBox::Object e;
+		e["name"] = JsonBox::Value("Item " + std::to_string(i));
+		e["description"] = JsonBox::Value("A perfectly ordinary item");
+		o[itemId(i)] = JsonBox::Value(e);
+	}
+	JsonBox::Value(o).writeToFile(filename);
+
+	return;
+}
+
+// Write a creature, and n areas in a ring, each with a door to the next
+// one and a few random items
+void writeWorld(unsigned long long n, unsigned long long numItems, std::mt19937& rng)
+{
+	JsonBox::Object rat;
+	rat["name"] = JsonBox::Value("Rat");
+	rat["hp"] = JsonBox::Value(3);
+	rat["strength"] = JsonBox::Value(5);
+	rat["agility"] = JsonBox::Value(3);
+	rat["evasion"] = JsonBox::Value(0.015625);
+	rat["xp"] = JsonBox::Value(1);
+	JsonBox::Object creatures;
+	creatures["creature_rat"] = JsonBox::Value(rat);
+	JsonBox::Value(creatures).writeToFile("gb_creatures.json");
+
+	JsonBox::Object doors;
+	JsonBox::Object areas;
+	for(unsigned long long i = 0; i < n; ++i)
+	{
+		std::string doorId = "door_" + std::to_string(i);
+		JsonBox::Object door;
+		JsonBox::Array doorAreas;
+		doorAreas.push_back(JsonBox::Value(areaId(i)));
+		doorAreas.push_back(JsonBox::Value(areaId((i + 1) % n)));
+		door["description"] = JsonBox::Value("door");
+		door["areas"] = JsonBox::Value(doorAreas);
+		door["locked"] = JsonBox::Value(-1);
+		doors[doorId] = JsonBox::Value(door);
+
+		JsonBox::Object area;
+		JsonBox::Object inventory;
+		JsonBox::Array items;
+		for(int j = 0; j < 4; ++j)
+		{
+			JsonBox::Array pair;
+			pair.push_back(JsonBox::Value(itemId(rng() % numItems)));
+			pair.push_back(JsonBox::Value(int(rng() % 10 + 1)));
+			items.push_back(JsonBox::Value(pair));
+		}
+		inventory["items"] = JsonBox::Value(items);
+		inventory["weapons"] = JsonBox::Value(JsonBox::Array());
+		inventory["armor"] = JsonBox::Value(JsonBox::Array());
+		area["inventory"] = JsonBox::Value(inventory);
+		JsonBox::Array areaCreatures;
+		areaCreatures.push_back(JsonBox::Value("creature_rat"));
+		area["creatures"] = JsonBox::Value(areaCreatures);
+		JsonBox::Array areaDoors;
+		areaDoors.push_back(JsonBox::Value(doorId));
+		area["doors"] = JsonBox::Value(areaDoors);
+		areas[areaId(i)] = JsonBox::Value(area);
+	}
+	JsonBox::Value(doors).writeToFile("gb_doors.json");
+	JsonBox::Value(areas).writeToFile("gb_areas.json");
+
+	return;
+}
+
+// Items made directly rather than loaded, for the benchmarks that need
+// a lot of them
+std::vector<std::unique_ptr<Item>> makeItems(unsigned long long n)
+{
+	std::vector<std::unique_ptr<Item>> items;
+	for(unsigned long long i = 0; i < n; ++i)
+	{
+		items.push_back(std::unique_ptr<Item>(new Item(itemId(i), "Item", "An item")));
+	}
+
+	return items;
+}
+
+void benchEntityManager(std::mt19937& rng)
+{
+	for(auto n : sizes({ 100, 10000 }))
+	{
+		writeItems("gb_items.json", n);
+
+		std::unique_ptr<EntityManager> mgr;
+		run("entity_load_json", n, 1,
+			[&]() { mgr.reset(new EntityManager); },
+			[&]() { mgr->loadJson<Item>("gb_items.json"); });
+
+		// Look up ids in a random order
+		std::vector<std::string> ids;
+		for(unsigned int i = 0; i < 1000; ++i) ids.push_back(itemId(rng() % n));
+		run("entity_get", n, ids.size(), [](){},
+			[&]()
+			{
+				for(auto& id : ids)
+				{
+					if(mgr->getEntity<Item>(id) == nullptr) std::abort();
+				}
+			});
+	}
+	std::remove("gb_items.json");
+
+	return;
+}
+
+void benchInventory(std::mt19937& rng)
+{
+	for(auto n : sizes({ 10, 1000, 100000 }))
+	{
+		std::vector<std::unique_ptr<Item>> items = makeItems(n);
+		Inventory inventory;
+		for(auto& item : items) inventory.add(item.get(), 1000000);
+
+		// The same random items for every operation
+		unsigned int ops = opsFor(n);
+		std::vector<Item*> picks;
+		std::vector<unsigned int> positions;
+		for(unsigned int i = 0; i < ops; ++i)
+		{
+			picks.push_back(items[rng() % n].get());
+			positions.push_back(rng() % n);
+		}
+
+		run("inventory_add", n, ops, [](){},
+			[&]() { for(auto item : picks) inventory.add(item, 1); });
+		run("inventory_remove", n, ops, [](){},
+			[&]() { for(auto item : picks) inventory.remove(item, 1); });
+		run("inventory_count", n, ops, [](){},
+			[&]()
+			{
+				int total = 0;
+				for(auto item : picks) total += inventory.count(item);
+				if(total == 0) std::abort();
+			});
+		run("inventory_get", n, ops, [](){},
+			[&]()
+			{
+				for(auto position : positions)
+				{
+					if(inventory.get<Item>(position) == nullptr) std::abort();
+				}
+			});
+
+		// Merge a handful of stacks, some already held and some not, into
+		// a fresh copy of the inventory each time
+		std::vector<std::unique_ptr<Item>> extra;
+		for(unsigned int i = 0; i < 10; ++i)
+		{
+			extra.push_back(std::unique_ptr<Item>(new Item(itemId(n + i), "Item", "An item")));
+		}
+		Inventory other;
+		for(unsigned int i = 0; i < 10; ++i)
+		{
+			other.add(items[rng() % n].get(), 1);
+			other.add(extra[i].get(), 1);
+		}
+		Inventory target;
+		run("inventory_merge", n, 1,
+			[&]() { target = inventory; },
+			[&]() { target.merge(&other); });
+	}
+
+	return;
+}
+
+void benchCreature()
+{
+	Creature attacker("creature_a", "Attacker", 1000000000, 50, 10, 0.1, 0);
+	Creature defender("creature_b", "Defender", 1000000000, 50, 10, 0.1, 0);
+	run("creature_attack", 1, 1000, [](){},
+		[&]()
+		{
+			for(unsigned int i = 0; i < 1000; ++i) attacker.attack(&defender);
+		});
+
+	return;
+}
+
+void benchBattle()
+{
+	for(auto n : sizes({ 2, 16, 128 }))
+	{
+		// Nobody dies, so every turn does the same amount of work
+		std::vector<Creature> fighters;
+		std::vector<Creature*> combatants;
+		std::ostringstream sink;
+		std::unique_ptr<Battle> battle;
+		run("battle_next_turn", n, 1,
+			[&]()
+			{
+				fighters.clear();
+				fighters.push_back(Creature("player", "Player", 1000000000, 20, 10, 0.1, 0));
+				for(unsigned int i = 1; i < n; ++i)
+				{
+					fighters.push_back(Creature("creature_rat", "Rat", 1000000000, 5, 3, 0.015625, 1));
+				}
+				combatants.clear();
+				for(auto& fighter : fighters) combatants.push_back(&fighter);
+				sink.str("");
+				battle.reset(new Battle(combatants, std::vector<Horde*>(), sink));
+				// Choose to attack, then the target choice runs the turn
+				battle->answer(1);
+			},
+			[&]() { battle->answer(1); });
+	}
+
+	return;
+}
+
+void benchSaves(std::mt19937& rng)
+{
+	for(auto n : sizes({ 10, 1000, 10000 }))
+	{
+		writeItems("gb_items.json", 100);
+		writeWorld(n, 100, rng);
+		EntityManager mgr;
+		mgr.loadJson<Item>("gb_items.json");
+		mgr.loadJson<Creature>("gb_creatures.json");
+		mgr.loadJson<Door>("gb_doors.json");
+		mgr.loadJson<Area>("gb_areas.json");
+		WorldOverlay world(&mgr);
+
+		// A player who has been everywhere, and picked up what was there
+		Player player("gb_player", 250, 60, 55, 0.1, 180000, 50, "Fighter");
+		for(unsigned long long i = 0; i < n; ++i)
+		{
+			player.visitedAreas.insert(areaId(i));
+			Area* area = world.editArea(areaId(i));
+			player.inventory.merge(&area->items);
+			area->items.clear();
+		}
+		player.currentArea = areaId(0);
+
+		run("player_snapshot", n, 1, [](){},
+			[&]() { player.snapshot(world, SaveFormat::JSON); });
+		run("player_save", n, 1, [](){},
+			[&]() { player.save(world, SaveFormat::JSON); });
+		run("player_load", n, 1, [](){},
+			[&]()
+			{
+				SaveData data;
+				if(data.read("gb_player") != SaveStatus::LOADED) std::abort();
+				WorldOverlay loaded(&mgr);
+				Player p(data, loaded);
+			});
+
+		std::remove("gb_player.json");
+		std::remove("gb_player_areas.json");
+		std::remove("gb_player.commit");
+	}
+	std::remove("gb_items.json");
+	std::remove("gb_creatures.json");
+	std::remove("gb_doors.json");
+	std::remove("gb_areas.json");
+
+	return;
+}
+
+void benchArea()
+{
+	for(auto n : sizes({ 10, 1000, 10000 }))
+	{
+		std::vector<std::unique_ptr<Item>> items = makeItems(n);
+		Inventory inventory;
+		for(auto& item : items) inventory.add(item.get(), 3);
+		Creature rat("creature_rat", "Rat", 3, 5, 3, 0.015625, 1);
+		Area area("area_bench", Dialogue("An area", {}), inventory,
+			std::vector<Creature*>(4, &rat));
+
+		EntityManager mgr;
+		WorldOverlay world(&mgr);
+		run("area_get_json", n, 1, [](){},
+			[&]() { area.getJson(world); });
+	}
+
+	return;
+}
+
+int main(int argc, char* argv[])
+{
+	for(int i = 1; i < argc; ++i)
+	{
+		std::string arg = argv[i];
+		if(arg == "--quick") quick = true;
+		else filter = arg;
+	}
+
+	// The game's own randomness, such as in attacks, comes from rand
+	std::srand(seed);
+	std::mt19937 rng(seed);
+
+	benchEntityManager(rng);
+	benchInventory(rng);
+	benchCreature();
+	benchBattle();
+	benchSaves(rng);
+	benchArea();
+
+	return 0;
+}
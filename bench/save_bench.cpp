@@ -0,0 +1,259 @@
+// Compares the size and speed of the JSON and binary save formats for a
+// late-game player, who has picked up a lot of items and visited a lot
+// of areas. Content is generated to files in the working directory
+// before being loaded, and removed again afterwards
+#include <iostream>
+#include <sstream>
+#include <fstream>
+#include <string>
+#include <chrono>
+#include <cstdio>
+#include <cstdlib>
+#include <JsonBox.h>
+
+#include "../src/item.hpp"
+#include "../src/weapon.hpp"
+#include "../src/armor.hpp"
+#include "../src/creature.hpp"
+#include "../src/door.hpp"
+#include "../src/area.hpp"
+#include "../src/player.hpp"
+#include "../src/save_data.hpp"
+#include "../src/binary_save.hpp"
+#include "../src/binary_io.hpp"
+#include "../src/entity_manager.hpp"
+#include "../src/world_overlay.hpp"
+
+const int numItems = 400;
+const int numWeapons = 100;
+const int numArmor = 100;
+const int numAreas = 300;
+const int iterations = 20;
+
+// Write an entity file of the given type, with one entity per id
+void writeItems(std::string filename, std::string prefix, int n, std::string statName)
+{
+	JsonBox::Object o;
+	for(int i = 0; i < n; ++i)
+	{
+		JsonBox::Object e;
+		e["name"] = JsonBox::Value(prefix + " " + std::to_string(i));
+		e["description"] = JsonBox::Value("A perfectly ordinary " + prefix);
+		if(statName != "") e[statName] = JsonBox::Value(i % 20);
+		o[prefix + "_" + std::to_string(i)] = JsonBox::Value(e);
+	}
+	JsonBox::Value(o).writeToFile(filename);
+}
+
+// Every area links to the next one and holds a handful of items
+void writeAreas()
+{
+	JsonBox::Object doors;
+	JsonBox::Object areas;
+	for(int i = 0; i < numAreas; ++i)
+	{
+		std::string id = "area_" + std::to_string(i);
+		std::string next = "area_" + std::to_string((i + 1) % numAreas);
+		std::string doorId = "door_" + std::to_string(i);
+
+		JsonBox::Object door;
+		JsonBox::Array doorAreas;
+		doorAreas.push_back(JsonBox::Value(id));
+		doorAreas.push_back(JsonBox::Value(next));
+		door["description"] = JsonBox::Value("door");
+		door["areas"] = JsonBox::Value(doorAreas);
+		door["locked"] = JsonBox::Value(i % 3 - 1);
+		doors[doorId] = JsonBox::Value(door);
+
+		JsonBox::Object area;
+		JsonBox::Object inventory;
+		JsonBox::Array items;
+		for(int j = 0; j < 8; ++j)
+		{
+			JsonBox::Array pair;
+			pair.push_back(JsonBox::Value("item_" + std::to_string((i * 8 + j) % numItems)));
+			pair.push_back(JsonBox::Value(j + 1));
+			items.push_back(JsonBox::Value(pair));
+		}
+		inventory["items"] = JsonBox::Value(items);
+		inventory["weapons"] = JsonBox::Value(JsonBox::Array());
+		inventory["armor"] = JsonBox::Value(JsonBox::Array());
+		area["inventory"] = JsonBox::Value(inventory);
+		JsonBox::Array creatures;
+		creatures.push_back(JsonBox::Value("creature_rat"));
+		area["creatures"] = JsonBox::Value(creatures);
+		JsonBox::Array areaDoors;
+		areaDoors.push_back(JsonBox::Value(doorId));
+		area["doors"] = JsonBox::Value(areaDoors);
+		areas[id] = JsonBox::Value(area);
+	}
+	JsonBox::Value(doors).writeToFile("bench_doors.json");
+	JsonBox::Value(areas).writeToFile("bench_areas.json");
+}
+
+void writeCreatures()
+{
+	JsonBox::Object rat;
+	rat["name"] = JsonBox::Value("Rat");
+	rat["hp"] = JsonBox::Value(3);
+	rat["strength"] = JsonBox::Value(5);
+	rat["agility"] = JsonBox::Value(3);
+	rat["evasion"] = JsonBox::Value(0.015625);
+	rat["xp"] = JsonBox::Value(1);
+	JsonBox::Object o;
+	o["creature_rat"] = JsonBox::Value(rat);
+	JsonBox::Value(o).writeToFile("bench_creatures.json");
+}
+
+// Time how long f takes on average, in microseconds
+template <typename F>
+double timeIt(F f)
+{
+	auto start = std::chrono::steady_clock::now();
+	for(int i = 0; i < iterations; ++i) f();
+	auto end = std::chrono::steady_clock::now();
+	return std::chrono::duration<double, std::micro>(end - start).count() / iterations;
+}
+
+// Stop the benchmark if a check of the binary format fails
+void check(bool ok, const std::string& what)
+{
+	if(ok) return;
+	std::cerr << "binary format check failed: " << what << "\n";
+	std::exit(1);
+}
+
+// Check that saves come back the same after being written and read in
+// the binary format, including saves written by older versions of it,
+// and that damaged saves and saves from newer versions are refused
+void checkFormat(Player& player, WorldOverlay& world)
+{
+	SaveData snapshot = player.snapshot(world, SaveFormat::BINARY);
+	std::string bytes = BinarySave::encode(snapshot);
+	SaveData decoded;
+	check(BinarySave::decode(bytes, decoded), "current version decodes");
+	check(BinarySave::encode(decoded) == bytes, "current version round trip");
+
+	// Version 1 wrote empty equipment slots as "nullptr", and should be
+	// read as though it were written by the current version
+	std::string old = BinarySave::encode(snapshot, 1);
+	SaveData migrated;
+	check(BinarySave::decode(old, migrated), "version 1 decodes");
+	check(BinarySave::encode(migrated) == bytes, "version 1 migrates");
+	Player loaded(migrated, world);
+	check(loaded.equippedWeapon == player.equippedWeapon, "version 1 weapon");
+	check(loaded.equippedArmor == player.equippedArmor, "version 1 armor");
+
+	// The version follows the magic bytes, and is a single byte for now
+	std::string newer = bytes;
+	newer[4] = char(BinarySave::version + 1);
+	SaveData refused;
+	check(!BinarySave::decode(newer, refused), "newer version refused");
+	check(!BinarySave::decode(bytes.substr(0, bytes.size() / 2), refused), "truncated save refused");
+	check(!BinarySave::decode("RPGX" + bytes.substr(4), refused), "bad magic refused");
+
+	// Sections added by a later version are skipped
+	ByteWriter extra;
+	extra.bytes = bytes;
+	extra.putVarint(99);
+	extra.putString("from the future");
+	SaveData skipped;
+	check(BinarySave::decode(extra.bytes, skipped), "unknown section skipped");
+	check(BinarySave::encode(skipped) == bytes, "unknown section ignored");
+
+	return;
+}
+
+int main()
+{
+	writeItems("bench_items.json", "item", numItems, "");
+	writeItems("bench_weapons.json", "weapon", numWeapons, "damage");
+	writeItems("bench_armor.json", "armor", numArmor, "defense");
+	writeCreatures();
+	writeAreas();
+
+	EntityManager mgr;
+	mgr.loadJson<Item>("bench_items.json");
+	mgr.loadJson<Weapon>("bench_weapons.json");
+	mgr.loadJson<Armor>("bench_armor.json");
+	mgr.loadJson<Creature>("bench_creatures.json");
+	mgr.loadJson<Door>("bench_doors.json");
+	mgr.loadJson<Area>("bench_areas.json");
+	WorldOverlay world(&mgr);
+
+	// Check the format with both empty and filled equipment slots
+	Player beginner("check", 15, 5, 4, 1.0/64.0, 0, 1, "Rogue");
+	beginner.visitedAreas.insert("area_0");
+	checkFormat(beginner, world);
+
+	// A player who has collected some of everything and been everywhere
+	Player player("bench", 250, 60, 55, 0.1, 180000, 50, "Fighter");
+	for(int i = 0; i < numItems; ++i)
+		player.inventory.add(mgr.getEntity<Item>("item_" + std::to_string(i)), i * 37 % 1000 + 1);
+	for(int i = 0; i < numWeapons; ++i)
+		player.inventory.add(mgr.getEntity<Weapon>("weapon_" + std::to_string(i)), 1);
+	for(int i = 0; i < numArmor; ++i)
+		player.inventory.add(mgr.getEntity<Armor>("armor_" + std::to_string(i)), 1);
+	player.equipWeapon(mgr.getEntity<Weapon>("weapon_7"));
+	player.equipArmor(mgr.getEntity<Armor>("armor_3"));
+	for(int i = 0; i < numAreas; ++i)
+		player.visitedAreas.insert("area_" + std::to_string(i));
+	checkFormat(player, world);
+	std::cout << "binary format checks passed\n";
+
+	// Taking the snapshot as Json values and applying a loaded save to
+	// the player cost the same whichever format is used, so they're timed
+	// separately
+	SaveData snapshot;
+	double snapshotTime = timeIt([&]() { snapshot = player.snapshot(world, SaveFormat::BINARY); });
+	double applyTime = timeIt([&]() { Player p(snapshot, world); });
+
+	// JSON, building the values and then writing them out as text
+	std::string jsonPlayer, jsonAreas;
+	double jsonSave = timeIt([&]()
+	{
+		std::ostringstream a, b;
+		snapshot.player.writeToStream(a);
+		snapshot.areas.writeToStream(b);
+		jsonPlayer = a.str();
+		jsonAreas = b.str();
+	});
+
+	// JSON, written straight out as text by the snapshot
+	SaveData streamed;
+	double streamedSave = timeIt([&]() { streamed = player.snapshot(world, SaveFormat::JSON); });
+	double jsonLoad = timeIt([&]()
+	{
+		SaveData data;
+		data.player.loadFromString(jsonPlayer);
+		data.areas.loadFromString(jsonAreas);
+	});
+
+	// Binary
+	std::string binary;
+	double binarySave = timeIt([&]() { binary = BinarySave::encode(snapshot); });
+	double binaryLoad = timeIt([&]()
+	{
+		SaveData data;
+		BinarySave::decode(binary, data);
+	});
+
+	std::cout << "snapshot " << snapshotTime << " us, apply " << applyTime << " us\n";
+	std::cout << "format  bytes     encode (us)  decode (us)\n";
+	std::cout << "json    " << jsonPlayer.size() + jsonAreas.size()
+		<< "    " << jsonSave << "    " << jsonLoad << "\n";
+	std::cout << "binary  " << binary.size()
+		<< "    " << binarySave << "    " << binaryLoad << "\n";
+	std::cout << "json snapshot and encode: " << snapshotTime + jsonSave << " us as values, "
+		<< streamedSave << " us streamed (" << streamed.playerText.size() + streamed.areasText.size()
+		<< " bytes)\n";
+
+	std::remove("bench_items.json");
+	std::remove("bench_weapons.json");
+	std::remove("bench_armor.json");
+	std::remove("bench_creatures.json");
+	std::remove("bench_doors.json");
+	std::remove("bench_areas.json");
+
+	return 0;
+}
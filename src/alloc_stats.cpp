@@ -0,0 +1,182 @@
+#include <atomic>
+#include <new>
+#include <cstdlib>
+#include <cstdio>
+#include <iostream>
+
+#include "alloc_stats.hpp"
+
+static const int numTags = int(AllocTag::NUM_TAGS);
+
+// Plain arrays of atomics with no constructors to run, so they can be
+// used by allocations made before main, or during static construction
+static std::atomic<unsigned long long> counts[numTags];
+static std::atomic<unsigned long long> bytes[numTags];
+static std::atomic<long long> live[numTags];
+static std::atomic<long long> peaks[numTags];
+
+static thread_local AllocTag currentTag = AllocTag::OTHER;
+
+const char* allocTagName(AllocTag tag)
+{
+	switch(tag)
+	{
+		case AllocTag::OTHER: return "other";
+		case AllocTag::INVENTORY: return "inventory";
+		case AllocTag::BATTLE: return "battle";
+		case AllocTag::SAVE: return "save";
+		case AllocTag::DIALOGUE: return "dialogue";
+		case AllocTag::ITEM: return "loader:item";
+		case AllocTag::WEAPON: return "loader:weapon";
+		case AllocTag::ARMOR: return "loader:armor";
+		case AllocTag::CREATURE: return "loader:creature";
+		case AllocTag::AREA: return "loader:area";
+		case AllocTag::DOOR: return "loader:door";
+		case AllocTag::LOOT: return "loader:loot";
+		default: return "?";
+	}
+}
+
+AllocStats::Counters AllocStats::get(AllocTag tag)
+{
+	int i = int(tag);
+	Counters c;
+	c.count = counts[i].load(std::memory_order_relaxed);
+	c.bytes = bytes[i].load(std::memory_order_relaxed);
+	c.live = live[i].load(std::memory_order_relaxed);
+	c.peak = peaks[i].load(std::memory_order_relaxed);
+
+	return c;
+}
+
+void AllocStats::resetTurn()
+{
+	for(int i = 0; i < numTags; ++i)
+	{
+		counts[i].store(0, std::memory_order_relaxed);
+		bytes[i].store(0, std::memory_order_relaxed);
+		peaks[i].store(live[i].load(std::memory_order_relaxed), std::memory_order_relaxed);
+	}
+
+	return;
+}
+
+void AllocStats::report(std::ostream& out)
+{
+	// Formatted into a buffer first, so that writing the report doesn't
+	// change the numbers it's reporting
+	char line[128];
+	for(int i = 0; i < numTags; ++i)
+	{
+		Counters c = AllocStats::get(AllocTag(i));
+		if(c.count == 0 && c.live == 0) continue;
+		std::snprintf(line, sizeof(line), "%-16s %8llu allocs %10llu bytes %10lld live %10lld peak\n",
+			allocTagName(AllocTag(i)), c.count, c.bytes, c.live, c.peak);
+		out << line;
+	}
+
+	return;
+}
+
+AllocTag AllocStats::current()
+{
+	return currentTag;
+}
+
+void AllocStats::setCurrent(AllocTag tag)
+{
+	currentTag = tag;
+
+	return;
+}
+
+#ifdef RPG_ALLOC_STATS
+
+// Stored in front of every block, so that when it's freed we know how big
+// it was and what it was counted under. Kept to 16 bytes so the block
+// after it is still suitably aligned for anything
+class AllocHeader
+{
+	public:
+
+	std::size_t size;
+	AllocTag tag;
+};
+static const std::size_t headerSize = 16;
+static_assert(sizeof(AllocHeader) <= headerSize, "allocation header too big");
+
+static void* allocate(std::size_t size)
+{
+	if(size > std::size_t(-1) - headerSize) return nullptr;
+	void* p = std::malloc(size + headerSize);
+	if(p == nullptr) return nullptr;
+
+	AllocHeader* header = static_cast<AllocHeader*>(p);
+	header->size = size;
+	header->tag = currentTag;
+
+	int i = int(header->tag);
+	counts[i].fetch_add(1, std::memory_order_relaxed);
+	bytes[i].fetch_add(size, std::memory_order_relaxed);
+	long long now = live[i].fetch_add(size, std::memory_order_relaxed) + size;
+	long long peak = peaks[i].load(std::memory_order_relaxed);
+	while(now > peak && !peaks[i].compare_exchange_weak(peak, now, std::memory_order_relaxed)) {}
+
+	return static_cast<char*>(p) + headerSize;
+}
+
+static void deallocate(void* p)
+{
+	if(p == nullptr) return;
+
+	AllocHeader* header = reinterpret_cast<AllocHeader*>(static_cast<char*>(p) - headerSize);
+	live[int(header->tag)].fetch_sub(header->size, std::memory_order_relaxed);
+	std::free(header);
+
+	return;
+}
+
+void* operator new(std::size_t size)
+{
+	void* p = allocate(size);
+	if(p == nullptr) throw std::bad_alloc();
+
+	return p;
+}
+
+void* operator new[](std::size_t size)
+{
+	return operator new(size);
+}
+
+void* operator new(std::size_t size, const std::nothrow_t&) noexcept
+{
+	return allocate(size);
+}
+
+void* operator new[](std::size_t size, const std::nothrow_t&) noexcept
+{
+	return allocate(size);
+}
+
+void operator delete(void* p) noexcept
+{
+	deallocate(p);
+}
+
+void operator delete[](void* p) noexcept
+{
+	deallocate(p);
+}
+
+void operator delete(void* p, const std::nothrow_t&) noexcept
+{
+	deallocate(p);
+}
+
+void operator delete[](void* p, const std::nothrow_t&) noexcept
+{
+	deallocate(p);
+}
+
+#endif /* RPG_ALLOC_STATS */
@@ -0,0 +1,84 @@
+#ifndef ALLOC_STATS_HPP
+#define ALLOC_STATS_HPP
+
+#include <iostream>
+
+// What an allocation was made for. Entities being loaded are counted by
+// their type, so the loader's share can be seen for each one
+enum class AllocTag { OTHER, INVENTORY, BATTLE, SAVE, DIALOGUE,
+	ITEM, WEAPON, ARMOR, CREATURE, AREA, DOOR, LOOT, NUM_TAGS };
+
+// Name of the tag, as shown in reports
+const char* allocTagName(AllocTag tag);
+
+// Counts every allocation made with new, and how many bytes it was for,
+// under the tag of the innermost ALLOC_SCOPE on the thread that made it.
+// Memory is counted against the same tag when it's freed, so the bytes
+// still in use by each tag, and the most there has been, are known too.
+//
+// Only compiled in when RPG_ALLOC_STATS is defined, since counting means
+// replacing operator new and delete for the whole program. Otherwise
+// ALLOC_SCOPE does nothing and every count stays at zero
+#ifdef RPG_ALLOC_STATS
+#define ALLOC_CONCAT2(a, b) a##b
+#define ALLOC_CONCAT(a, b) ALLOC_CONCAT2(a, b)
+#define ALLOC_SCOPE(tag) AllocScope ALLOC_CONCAT(allocScope, __LINE__)(tag)
+#else
+#define ALLOC_SCOPE(tag)
+#endif
+
+class AllocStats
+{
+	public:
+
+	class Counters
+	{
+		public:
+
+		// Allocations made, and bytes asked for, since the turn started
+		unsigned long long count;
+		unsigned long long bytes;
+
+		// Bytes allocated and not yet freed, and the most there have been
+		// since the turn started
+		long long live;
+		long long peak;
+	};
+
+	// The counts for one tag
+	static Counters get(AllocTag tag);
+
+	// Start counting a new turn
+	static void resetTurn();
+
+	// Write a line for every tag that has allocated anything this turn
+	// or still has memory in use
+	static void report(std::ostream& out);
+
+	// Tag that allocations on this thread are being counted under
+	static AllocTag current();
+	static void setCurrent(AllocTag tag);
+};
+
+// Counts allocations under the tag until the end of the block
+class AllocScope
+{
+	private:
+
+	AllocTag previous;
+
+	public:
+
+	AllocScope(AllocTag tag)
+	{
+		this->previous = AllocStats::current();
+		AllocStats::setCurrent(tag);
+	}
+
+	~AllocScope()
+	{
+		AllocStats::setCurrent(this->previous);
+	}
+};
+
+#endif /* ALLOC_STATS_HPP */
@@ -9,24 +9,61 @@
 #include "creature.hpp"
 #include "dialogue.hpp"
 #include "entity_manager.hpp"
+#include "json_writer.hpp"
+#include "world_overlay.hpp"
+
+// Read a list of creatures, where each creature is either an id string,
+// or an array of the type [id, count] which creates a horde of that many
+// creatures
+static void loadCreatureList(JsonBox::Value& v, EntityManager* mgr,
+	std::vector<Creature*>& creatures, std::vector<Horde>& hordes)
+{
+	for(auto creature : v.getArray())
+	{
+		if(creature.isString())
+		{
+			creatures.push_back(mgr->getEntity<Creature>(creature.getString()));
+		}
+		else
+		{
+			hordes.push_back(Horde(mgr->getEntity<Creature>(creature.getArray()[0].getString()),
+				creature.getArray()[1].getInteger()));
+		}
+	}
+
+	return;
+}
 
 Area::Area(std::string id, Dialogue dialogue, Inventory items,
 		std::vector<Creature*> creatures) : Entity(id)
 {
+	this->respawnDelay = 0;
+	this->respawnAt = 0;
 	this->dialogue = dialogue;
 	this->items = items;
 	for(auto creature : creatures)
 	{
-		this->creatures.push_back(*creature);
+		this->creatures.push_back(CreatureInstance(creature));
 	}
+	this->setBase();
 }
 
 Area::Area(std::string id, JsonBox::Value& v, EntityManager* mgr) : Entity(id)
 {
+	this->respawnDelay = 0;
+	this->respawnAt = 0;
 	this->load(v, mgr);
+	this->setBase();
 }
 
 void Area::load(JsonBox::Value& v, EntityManager* mgr)
+{
+	this->load(v, mgr, nullptr);
+
+	return;
+}
+
+void Area::load(JsonBox::Value& v, EntityManager* mgr, WorldOverlay* world)
 {
 	JsonBox::Object o = v.getObject();
 
@@ -39,14 +76,36 @@ void Area::load(JsonBox::Value& v, EntityManager* mgr)
 	// Build the inventory
 	this->items = Inventory(o["inventory"], mgr);
 
-	// Build the creature list
+	// Build the creature list, creating a new creature instance of each
+	// version in the entity manager
+	std::vector<Creature*> creatures;
 	this->creatures.clear();
-	for(auto creature : o["creatures"].getArray())
+	this->hordes.clear();
+	loadCreatureList(o["creatures"], mgr, creatures, this->hordes);
+	for(auto creature : creatures)
 	{
-		// Create a new creature instance indentical to the version
-		// in the entity manager
-		Creature c(*mgr->getEntity<Creature>(creature.getString()));
-		this->creatures.push_back(c);
+		this->creatures.push_back(CreatureInstance(creature));
+	}
+
+	// Areas can be given a spawn table of the type
+	// {"delay": moves, "creatures": [...]}, otherwise the creatures never
+	// come back once they've been killed. If no creatures are given then
+	// the ones the area starts with reappear
+	if(o.find("respawn") != o.end())
+	{
+		JsonBox::Object respawn = o["respawn"].getObject();
+		this->respawnDelay = respawn["delay"].getInteger();
+		this->spawnCreatures.clear();
+		this->spawnHordes.clear();
+		if(respawn.find("creatures") != respawn.end())
+		{
+			loadCreatureList(respawn["creatures"], mgr, this->spawnCreatures, this->spawnHordes);
+		}
+		else
+		{
+			this->spawnCreatures = creatures;
+			this->spawnHordes = this->hordes;
+		}
 	}
 	// Attach doors
 	if(o.find("doors") != o.end())
@@ -64,7 +123,10 @@ void Area::load(JsonBox::Value& v, EntityManager* mgr)
 			else
 			{
 				d = mgr->getEntity<Door>(door.getArray()[0].getString());
-				d->locked = door.getArray()[1].getInteger();
+				if(world != nullptr)
+					world->setLocked(d, door.getArray()[1].getInteger());
+				else
+					d->locked = door.getArray()[1].getInteger();
 			}
 			this->doors.push_back(d);
 		}
@@ -73,32 +135,272 @@ void Area::load(JsonBox::Value& v, EntityManager* mgr)
 	return;
 }
 
-JsonBox::Object Area::getJson()
+void Area::setBase()
+{
+	this->baseItems = this->items;
+	this->baseCreatures.clear();
+	for(auto& creature : this->creatures)
+	{
+		this->baseCreatures.push_back(creature.base);
+	}
+	this->baseHordes = this->hordes;
+	this->baseLocks.clear();
+	for(auto door : this->doors)
+	{
+		this->baseLocks.push_back(door->locked);
+	}
+
+	return;
+}
+
+void Area::resetToBase(WorldOverlay& world)
+{
+	this->items = this->baseItems;
+	this->creatures.clear();
+	for(auto base : this->baseCreatures)
+	{
+		this->creatures.push_back(CreatureInstance(base));
+	}
+	this->hordes = this->baseHordes;
+	this->respawnAt = 0;
+	for(unsigned int i = 0; i < this->doors.size(); ++i)
+	{
+		world.setLocked(this->doors[i], this->baseLocks[i]);
+	}
+
+	return;
+}
+
+void Area::loadDelta(JsonBox::Value& v, WorldOverlay& world)
+{
+	JsonBox::Object o = v.getObject();
+	EntityManager* mgr = world.mgr;
+
+	this->resetToBase(world);
+
+	// Adjust the item quantities
+	if(o.find("inventory_delta") != o.end())
+		this->items.loadDelta(o["inventory_delta"], mgr);
+
+	// Remove creatures by their position in the base list. Go backwards
+	// so that removing one doesn't move the others
+	JsonBox::Array removed = o["creatures_removed"].getArray();
+	for(auto it = removed.rbegin(); it != removed.rend(); ++it)
+	{
+		unsigned int i = it->getInteger();
+		if(i < this->creatures.size())
+			this->creatures.erase(this->creatures.begin() + i);
+	}
+	for(auto creature : o["creatures_added"].getArray())
+	{
+		this->creatures.push_back(CreatureInstance(mgr->getEntity<Creature>(creature.getString())));
+	}
+
+	// Set when the creatures will come back, if they've been killed
+	if(o.find("respawn_at") != o.end())
+		this->respawnAt = o["respawn_at"].getInteger();
+
+	// Hordes are only saved when they've changed, and then all of them are
+	if(o.find("hordes") != o.end())
+	{
+		this->hordes.clear();
+		for(auto horde : o["hordes"].getArray())
+		{
+			this->hordes.push_back(Horde(mgr->getEntity<Creature>(horde.getArray()[0].getString()),
+				horde.getArray()[1].getInteger()));
+		}
+	}
+
+	// Set the doors that have been locked or unlocked
+	for(auto door : o["doors"].getArray())
+	{
+		Door* d = mgr->getEntity<Door>(door.getArray()[0].getString());
+		world.setLocked(d, door.getArray()[1].getInteger());
+	}
+
+	return;
+}
+
+bool Area::hasCreatures()
+{
+	for(auto& horde : this->hordes)
+	{
+		if(horde.count > 0) return true;
+	}
+
+	return this->creatures.size() > 0;
+}
+
+void Area::clearCreatures(unsigned int now)
+{
+	this->creatures.clear();
+	this->hordes.clear();
+	if(this->respawnDelay > 0) this->respawnAt = now + this->respawnDelay;
+
+	return;
+}
+
+void Area::respawn()
+{
+	for(auto creature : this->spawnCreatures)
+	{
+		this->creatures.push_back(CreatureInstance(creature));
+	}
+	this->hordes.insert(this->hordes.end(), this->spawnHordes.begin(), this->spawnHordes.end());
+	this->respawnAt = 0;
+
+	return;
+}
+
+bool Area::hordesChanged()
+{
+	if(this->hordes.size() != this->baseHordes.size()) return true;
+	for(unsigned int i = 0; i < this->hordes.size(); ++i)
+	{
+		if(this->hordes[i].base != this->baseHordes[i].base ||
+			this->hordes[i].count != this->baseHordes[i].count) return true;
+	}
+
+	return false;
+}
+
+unsigned int Area::matchBaseCreatures(std::vector<int>& removed)
+{
+	unsigned int j = 0;
+	for(unsigned int i = 0; i < this->baseCreatures.size(); ++i)
+	{
+		if(j < this->creatures.size() && this->creatures[j].base == this->baseCreatures[i])
+			++j;
+		else
+			removed.push_back(i);
+	}
+
+	return j;
+}
+
+JsonBox::Object Area::getJson(WorldOverlay& world)
 {
 	JsonBox::Object o;
-	// We don't need to save the dialogue because it doesn't change
+	// We don't need to save the dialogue because it doesn't change, and
+	// everything else only needs saving if it's different from the base
 
-	// Save the inventory
-	o["inventory"] = this->items.getJson();
+	// Save the changes to the inventory
+	JsonBox::Object inventory = this->items.getJsonDelta(this->baseItems);
+	if(!inventory.empty()) o["inventory_delta"] = JsonBox::Value(inventory);
 
-	// Save the creatures
-	JsonBox::Array a;
-	for(auto creature : this->creatures)
+	// Save the changes to the creatures
+	std::vector<int> removedPositions;
+	unsigned int j = this->matchBaseCreatures(removedPositions);
+	JsonBox::Array removed;
+	for(auto i : removedPositions)
+	{
+		removed.push_back(JsonBox::Value(i));
+	}
+	JsonBox::Array added;
+	for(; j < this->creatures.size(); ++j)
 	{
-		a.push_back(JsonBox::Value(creature.id));
+		added.push_back(JsonBox::Value(this->creatures[j].id()));
 	}
-	o["creatures"] = a;
+	if(!removed.empty()) o["creatures_removed"] = JsonBox::Value(removed);
+	if(!added.empty()) o["creatures_added"] = JsonBox::Value(added);
 
-	// Save the doors
-	a.clear();
-	for(auto door : this->doors)
+	// Save every horde if any of them have changed
+	if(this->hordesChanged())
 	{
+		JsonBox::Array hordes;
+		for(auto& horde : this->hordes)
+		{
+			JsonBox::Array h;
+			h.push_back(horde.base->id);
+			h.push_back(int(horde.count));
+			hordes.push_back(h);
+		}
+		o["hordes"] = JsonBox::Value(hordes);
+	}
+	if(this->respawnAt > 0) o["respawn_at"] = JsonBox::Value(int(this->respawnAt));
+
+	// Save the doors whose lock has changed
+	JsonBox::Array doors;
+	for(unsigned int i = 0; i < this->doors.size(); ++i)
+	{
+		if(world.locked(this->doors[i]) == this->baseLocks[i]) continue;
 		JsonBox::Array d;
-		d.push_back(door->id);
-		d.push_back(door->locked);
-		a.push_back(d);
+		d.push_back(this->doors[i]->id);
+		d.push_back(world.locked(this->doors[i]));
+		doors.push_back(d);
 	}
-	o["doors"] = a;
+	if(!doors.empty()) o["doors"] = JsonBox::Value(doors);
 
 	return o;
 }
+
+void Area::writeJson(JsonWriter& out, WorldOverlay& world)
+{
+	out.beginObject();
+
+	if(this->items.deltaSize(this->baseItems) > 0)
+	{
+		out.key("inventory_delta");
+		this->items.writeJsonDelta(out, this->baseItems);
+	}
+
+	std::vector<int> removed;
+	unsigned int j = this->matchBaseCreatures(removed);
+	if(!removed.empty())
+	{
+		out.key("creatures_removed");
+		out.beginArray();
+		for(auto i : removed) out.value(i);
+		out.endArray();
+	}
+	if(j < this->creatures.size())
+	{
+		out.key("creatures_added");
+		out.beginArray();
+		for(; j < this->creatures.size(); ++j) out.value(this->creatures[j].id());
+		out.endArray();
+	}
+
+	if(this->hordesChanged())
+	{
+		out.key("hordes");
+		out.beginArray();
+		for(auto& horde : this->hordes)
+		{
+			out.beginArray();
+			out.value(horde.base->id);
+			out.value(horde.count);
+			out.endArray();
+		}
+		out.endArray();
+	}
+	if(this->respawnAt > 0)
+	{
+		out.key("respawn_at");
+		out.value(this->respawnAt);
+	}
+
+	bool doorsChanged = false;
+	for(unsigned int i = 0; i < this->doors.size(); ++i)
+	{
+		if(world.locked(this->doors[i]) != this->baseLocks[i]) doorsChanged = true;
+	}
+	if(doorsChanged)
+	{
+		out.key("doors");
+		out.beginArray();
+		for(unsigned int i = 0; i < this->doors.size(); ++i)
+		{
+			if(world.locked(this->doors[i]) == this->baseLocks[i]) continue;
+			out.beginArray();
+			out.value(this->doors[i]->id);
+			out.value(world.locked(this->doors[i]));
+			out.endArray();
+		}
+		out.endArray();
+	}
+
+	out.endObject();
+
+	return;
+}
@@ -8,10 +8,13 @@
 #include "entity.hpp"
 #include "inventory.hpp"
 #include "creature.hpp"
+#include "horde.hpp"
 #include "dialogue.hpp"
+#include "json_writer.hpp"
 
 class EntityManager;
 class Door;
+class WorldOverlay;
 
 // Movement is achieved through the use of areas, which are contained
 // units of space consisting of an inventory, a list of creatures and
@@ -31,20 +34,80 @@ class Area : public Entity
 	// pointers
 	std::vector<Door*> doors;
 
-	// Creatures contained within the area. Not pointers because we want unique
-	// instances of the creatures
-	std::vector<Creature> creatures;
+	// Creatures contained within the area. Each instance only stores what
+	// can change, and shares everything else with the creature in the
+	// entity manager
+	std::vector<CreatureInstance> creatures;
+
+	// Large groups of identical creatures, stored as a count rather than
+	// as individual creatures
+	std::vector<Horde> hordes;
+
+	// Creatures that reappear some time after the area has been cleared
+	std::vector<Creature*> spawnCreatures;
+	std::vector<Horde> spawnHordes;
+
+	// Number of moves after the area is cleared before the creatures
+	// reappear, or 0 if they never do
+	unsigned int respawnDelay;
+
+	// Move count at which the creatures will reappear, or 0 if the area
+	// isn't waiting for them
+	unsigned int respawnAt;
+
+	// Contents of the area as they were when the area was first loaded
+	// from areas.json. Saves only store how the area differs from this
+	Inventory baseItems;
+	std::vector<Creature*> baseCreatures;
+	std::vector<Horde> baseHordes;
+	std::vector<int> baseLocks;
 
 	// Constructors
 	Area(std::string id, Dialogue dialogue, Inventory items,
 		std::vector<Creature*> creatures);
 	Area(std::string id, JsonBox::Value& v, EntityManager* mgr);
 
-	// Load the area from the given Json value
+	// Load the area from the given Json value. Door locks are set in the
+	// overlay if one is given, otherwise on the shared doors
 	void load(JsonBox::Value& v, EntityManager* mgr);
+	void load(JsonBox::Value& v, EntityManager* mgr, WorldOverlay* world);
+
+	// Match the creatures up with the base list in order. Any base
+	// creatures that can't be matched have been removed, and their
+	// positions are added to removed. Returns the position of the first
+	// creature that wasn't matched, after which the creatures were added
+	unsigned int matchBaseCreatures(std::vector<int>& removed);
+
+	// True if there are any creatures or hordes in the area
+	bool hasCreatures();
+
+	// Remove every creature from the area. If the area has a spawn table
+	// then the creatures will reappear respawnDelay moves after now
+	void clearCreatures(unsigned int now);
+
+	// Fill the area with the creatures from the spawn table
+	void respawn();
+
+	// True if the hordes differ from the base hordes
+	bool hordesChanged();
+
+	// Remember the current contents of the area as the base that
+	// changes are measured against
+	void setBase();
+
+	// Return the area to its base contents
+	void resetToBase(WorldOverlay& world);
+
+	// Load the changes described by the Json value on top of the
+	// base contents of the area, setting door locks in the overlay
+	void loadDelta(JsonBox::Value& v, WorldOverlay& world);
+
+	// Return a Json object representing how the area differs from its
+	// base contents, reading door locks from the overlay
+	JsonBox::Object getJson(WorldOverlay& world);
 
-	// Return a Json object representing the area
-	JsonBox::Object getJson();
+	// Write the same JSON as getJson without building the object first
+	void writeJson(JsonWriter& out, WorldOverlay& world);
 };
 
 #endif /* AREA_HPP */
@@ -0,0 +1,67 @@
+#include <string>
+#include <vector>
+#include <fstream>
+#include <chrono>
+
+#include "batch.hpp"
+#include "session.hpp"
+#include "renderer.hpp"
+
+bool Batch::load(const std::string& filename)
+{
+	std::ifstream file(filename);
+	if(!file) return false;
+
+	this->script.clear();
+	std::string line;
+	while(std::getline(file, line))
+	{
+		// Scripts written on Windows end their lines with \r\n
+		if(!line.empty() && line.back() == '\r') line.pop_back();
+		this->script.push_back(line);
+	}
+
+	return true;
+}
+
+void Batch::play(SessionContext* context, unsigned int numRuns, Renderer& screen)
+{
+	auto start = std::chrono::steady_clock::now();
+	for(unsigned int i = 0; i < numRuns; ++i)
+	{
+		std::string run = std::to_string(this->runs + 1);
+		Session session(context, screen.out);
+		screen.present();
+		for(auto line : this->script)
+		{
+			if(session.over()) break;
+			std::string::size_type pos;
+			while((pos = line.find("{run}")) != std::string::npos) line.replace(pos, 5, run);
+			session.feed(line);
+			screen.present();
+		}
+		this->turns += session.numTurns();
+		++this->runs;
+	}
+	auto end = std::chrono::steady_clock::now();
+	this->seconds += std::chrono::duration<double>(end - start).count();
+
+	return;
+}
+
+void Batch::report(std::ostream& out)
+{
+	out << "Played " << this->runs << " run" << (this->runs == 1 ? "" : "s")
+		<< ", " << this->turns << " turns in " << this->seconds << "s";
+	if(this->seconds > 0) out << " (" << this->turns / this->seconds << " turns/s)";
+	out << "\n";
+
+	return;
+}
+
+Batch::Batch()
+{
+	this->runs = 0;
+	this->turns = 0;
+	this->seconds = 0;
+}
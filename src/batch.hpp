@@ -0,0 +1,44 @@
+#ifndef BATCH_HPP
+#define BATCH_HPP
+
+#include <string>
+#include <vector>
+#include <iostream>
+
+class SessionContext;
+class Renderer;
+
+// Plays through a script of recorded input with nobody at the keyboard,
+// as fast as the game can go, for testing the whole game from start to
+// finish. The script holds one line of input per line, exactly as it
+// would be typed. It can be played any number of times, each time as a
+// new session, and {run} anywhere in the script is replaced with the
+// number of the run, so that each run can be given a different player
+// name and start from scratch rather than carrying on from the last
+class Batch
+{
+	private:
+
+	std::vector<std::string> script;
+
+	public:
+
+	// Totals over every run played so far
+	unsigned int runs;
+	unsigned long long turns;
+	double seconds;
+
+	// Read the script from a file, returning false if it can't be read
+	bool load(const std::string& filename);
+
+	// Play the script the given number of times, showing the game on the
+	// screen a frame at a time
+	void play(SessionContext* context, unsigned int numRuns, Renderer& screen);
+
+	// Write how long the runs took, and how many turns a second that is
+	void report(std::ostream& out);
+
+	Batch();
+};
+
+#endif /* BATCH_HPP */
@@ -6,15 +6,28 @@
 
 #include "battle.hpp"
 #include "creature.hpp"
+#include "horde.hpp"
 #include "dialogue.hpp"
+#include "event_bus.hpp"
+#include "trace.hpp"
+#include "alloc_stats.hpp"
 
 BattleEvent::BattleEvent(Creature* source, Creature* target, BattleEventType type)
 {
 	this->source = source;
 	this->target = target;
+	this->horde = nullptr;
 	this->type = type;
 }
 
+BattleEvent::BattleEvent(Horde* horde, Creature* target)
+{
+	this->source = nullptr;
+	this->target = target;
+	this->horde = horde;
+	this->type = BattleEventType::HORDE_ATTACK;
+}
+
 int BattleEvent::run()
 {
 	switch(type)
@@ -23,6 +36,8 @@ int BattleEvent::run()
 			return source->attack(target);
 		case BattleEventType::DEFEND:
 			return 0;
+		case BattleEventType::HORDE_ATTACK:
+			return horde->attack(target);
 		default:
 			return 0;
 	}
@@ -36,7 +51,8 @@ void Battle::kill(Creature* creature)
 	// Don't try and delete the creature if it doesn't exist
 	if(pos != this->combatants.end())
 	{
-		std::cout << creature->name << " is slain!\n";
+		this->out << creature->name << " is slain!\n";
+		if(this->events) this->events->publish(GameEvent(GameEventType::SLAIN, creature->name));
 
 		// Health == 0 is used in main as a condition to check if the creature is
 		// dead, but this function could be called when the creature is not killed
@@ -50,16 +66,34 @@ void Battle::kill(Creature* creature)
 	return;
 }
 
-Battle::Battle(std::vector<Creature*>& combatants)
+bool Battle::hordesLeft()
 {
+	for(auto horde : this->hordes)
+	{
+		if(horde->count > 0) return true;
+	}
+
+	return false;
+}
+
+Battle::Battle(std::vector<Creature*>& combatants, std::vector<Horde*> hordes,
+	std::ostream& out, EventBus* events) : out(out)
+{
+	ALLOC_SCOPE(AllocTag::BATTLE);
+
+	this->events = events;
 	this->combatants = combatants;
+	this->hordes = hordes;
 
-	// Construct the menu
-	this->battleOptions = Dialogue("What will you do?",
+	// Construct the menus, whose text is the same for every battle
+	static const Dialogue options("What will you do?",
 	{
 		"Attack",
 		"Defend"
 	});
+	this->battleOptions = options;
+	static const Dialogue who("Who?", {});
+	this->targetSelection = who;
 
 	// Store the unique creature names and whether there is
 	// only one or more of them. This code assumes that the
@@ -103,73 +137,160 @@ Battle::Battle(std::vector<Creature*>& combatants)
 		// the same as the original
 		com->name = newName;
 	}
+
+	this->beginTurn();
+}
+
+bool Battle::over()
+{
+	// Continue the battle until either the player dies,
+	// or there is only the player left
+	auto player = std::find_if(this->combatants.begin(), this->combatants.end(),
+		[](Creature* a) { return a->id == "player"; });
+
+	return player == this->combatants.end() ||
+		(this->combatants.size() <= 1 && !this->hordesLeft());
+}
+
+Dialogue* Battle::question()
+{
+	if(this->over()) return nullptr;
+
+	// Ask for the player's action (attack or defend), then who to attack
+	if(this->action < 0) return &this->battleOptions;
+
+	return &this->targetSelection;
 }
 
-void Battle::run()
+void Battle::answer(int choice)
 {
-	std::vector<Creature*>::iterator player;
-	std::vector<Creature*>::iterator end;
-	do
+	if(this->over()) return;
+
+	if(this->action < 0)
 	{
-		// Continue the battle until either the player dies,
-		// or there is only the player left
-		player = std::find_if(this->combatants.begin(), this->combatants.end(),
-			[](Creature* a) { return a->id == "player"; });
-		end = this->combatants.end();
+		this->action = choice;
+		// Defending doesn't need a target
+		if(choice == 2) this->nextTurn();
+		return;
+	}
+
+	// 0 isn't one of the targets, so leave the question to be asked again
+	if(choice < 1) return;
+	this->position = choice;
+	this->nextTurn();
+
+	return;
+}
 
-		this->nextTurn();
+void Battle::beginTurn()
+{
+	ALLOC_SCOPE(AllocTag::BATTLE);
+
+	this->action = -1;
+	this->position = -1;
+
+	// Sort the combatants in agility order
+	std::sort(combatants.begin(), combatants.end(), [](Creature* a, Creature* b) { return a->agility > b->agility; });
+
+	// Hordes with members left, also in agility order, so that they
+	// can be slotted into the event queue between the combatants
+	this->liveHordes.clear();
+	for(auto horde : this->hordes)
+	{
+		if(horde->count > 0) this->liveHordes.push_back(horde);
 	}
-	while(player != end && this->combatants.size() > 1);
+	std::sort(this->liveHordes.begin(), this->liveHordes.end(), [](Horde* a, Horde* b) { return a->base->agility > b->base->agility; });
+
+	// Create the target selection dialogue. The targets are the
+	// combatants other than the player, followed by the hordes, and are
+	// only written out when the dialogue is shown
+	ALLOC_SCOPE(AllocTag::DIALOGUE);
+	this->numTargets = this->combatants.size() - 1;
+	this->targetSelection.setExtraChoices(this->numTargets + this->liveHordes.size(),
+		[this](std::ostream& out, unsigned int n)
+	{
+		if(n >= this->numTargets)
+		{
+			Horde* horde = this->liveHordes[n - this->numTargets];
+			out << horde->base->name << " horde (" << horde->count << ")";
+			return;
+		}
+		for(auto target : this->combatants)
+		{
+			if(target->id == "player") continue;
+			if(n-- == 0)
+			{
+				out << target->name;
+				return;
+			}
+		}
+	});
 
 	return;
 }
 
 void Battle::nextTurn()
 {
+	TRACE_SCOPE("Battle::nextTurn");
+	ALLOC_SCOPE(AllocTag::BATTLE);
+
 	// Queue of battle events. Fastest combatants will be
 	// at the start of the queue, and so will go first,
 	// whereas slower ones will be at the back
 	std::queue<BattleEvent> events;
 
-	// Sort the combatants in agility order
-	std::sort(combatants.begin(), combatants.end(), [](Creature* a, Creature* b) { return a->agility > b->agility; });
+	unsigned int nextHorde = 0;
+
+	// Hordes always attack the player
+	Creature* player = *std::find_if(this->combatants.begin(), this->combatants.end(),
+		[](Creature* a) { return a->id == "player"; });
+
+	// Horde members singled out by the player this turn. They can't be
+	// added to the combatants whilst we're going through them
+	std::vector<Creature*> joining;
 
 	// Iterate over the combatants and decide what they should do,
 	// before adding the action to the event queue.
 	for(auto com : this->combatants)
 	{
-		if(com->id == "player")
+		// Any hordes faster than this combatant go first
+		while(nextHorde < this->liveHordes.size() && this->liveHordes[nextHorde]->base->agility > com->agility)
 		{
-			// Create the target selection dialogue
-			Dialogue targetSelection = Dialogue("Who?", {});
-			// Created every turn because some combatants may die
-			for(auto target : this->combatants)
-			{
-				if(target->id != "player")
-				{
-					targetSelection.addChoice(target->name);
-				}
-			}
-
-			// Ask the player for their action (attack or defend)
-			int choice = this->battleOptions.activate();
+			events.push(BattleEvent(this->liveHordes[nextHorde++], player));
+		}
 
-			switch(choice)
+		if(com->id == "player")
+		{
+			switch(this->action)
 			{
 				default:
 				case 1:
 				{
-					// Player is attacking, so ask for the target.
+					// Player is attacking the target they chose.
 					// Dialogue returns the number of the choice but with
 					// the player removed, so we have to do some fancy
 					// arithmetic to find the actual location of the target
 					// and then convert that to a pointer
-					int position = targetSelection.activate();
-					for(int i = 0; i < position; ++i)
+					int position = this->position;
+					Creature* target = nullptr;
+					if(position > int(this->numTargets))
+					{
+						// Single out one member of the horde to fight
+						Horde* horde = this->liveHordes[position-this->numTargets-1];
+						std::string name = horde->base->name + " (" + std::to_string(horde->count) + ")";
+						this->materialized.push_back(horde->materialize());
+						target = &this->materialized.back();
+						target->name = name;
+						joining.push_back(target);
+					}
+					else
 					{
-						if(this->combatants[i]->id == "player") ++position;
+						for(int i = 0; i < position; ++i)
+						{
+							if(this->combatants[i]->id == "player") ++position;
+						}
+						target = this->combatants[position-1];
 					}
-					Creature* target = this->combatants[position-1];
 					// Add the attack command to the event queue
 					events.push(BattleEvent(com, target, BattleEventType::ATTACK));
 					break;
@@ -185,12 +306,15 @@ void Battle::nextTurn()
 		else
 		{
 			// Simple enemy AI where enemy constantly attacks player
-			Creature* player = *std::find_if(this->combatants.begin(), this->combatants.end(),
-				[](Creature* a) { return a->id == "player"; });
-
 			events.push(BattleEvent(com, player, BattleEventType::ATTACK));
 		}
 	}
+	// Then the slowest hordes
+	while(nextHorde < this->liveHordes.size())
+	{
+		events.push(BattleEvent(this->liveHordes[nextHorde++], player));
+	}
+	this->combatants.insert(this->combatants.end(), joining.begin(), joining.end());
 
 	// Take each event from the queue in turn and process them,
 	// displaying the results
@@ -211,12 +335,18 @@ void Battle::nextTurn()
 				{
 					break;
 				}
-				std::cout << event.source->name
+				int damage = event.run();
+				this->out << event.source->name
 					<< " attacks "
 					<< event.target->name
 					<< " for "
-					<< event.run()
+					<< damage
 					<< " damage!\n";
+				if(this->events)
+				{
+					this->events->publish(GameEvent(GameEventType::ATTACK,
+						event.source->name, event.target->name, damage));
+				}
 				// Delete slain enemies
 				if(event.target->hp <= 0)
 				{
@@ -225,12 +355,43 @@ void Battle::nextTurn()
 				break;
 			}
 			case BattleEventType::DEFEND:
-				std::cout << event.source->name
+				this->out << event.source->name
 					<< " defends!\n";
 				break;
+			case BattleEventType::HORDE_ATTACK:
+			{
+				// The horde might have been whittled down to nothing, or
+				// the player might already be dead
+				auto b = this->combatants.end();
+				if(event.horde->count == 0 || std::find(this->combatants.begin(), b, event.target) == b)
+				{
+					break;
+				}
+				int damage = event.run();
+				this->out << event.horde->name()
+					<< " attacks "
+					<< event.target->name
+					<< " for "
+					<< damage
+					<< " damage!\n";
+				if(this->events)
+				{
+					this->events->publish(GameEvent(GameEventType::ATTACK,
+						event.horde->name(), event.target->name, damage));
+				}
+				if(event.target->hp <= 0)
+				{
+					this->kill(event.target);
+				}
+				break;
+			}
 			default:
 				break;
 		}
 		events.pop();
 	}
+
+	if(!this->over()) this->beginTurn();
+
+	return;
 }
@@ -2,14 +2,18 @@
 #define BATTLE_HPP
 
 #include <vector>
+#include <list>
+#include <iostream>
 
 #include "dialogue.hpp"
+#include "creature.hpp"
 
-class Creature;
+class Horde;
+class EventBus;
 
 // Possible event types, should equate to what the player
-// can do in a battle
-enum class BattleEventType { ATTACK, DEFEND };
+// can do in a battle, or what a horde can do
+enum class BattleEventType { ATTACK, DEFEND, HORDE_ATTACK };
 
 class BattleEvent
 {
@@ -19,11 +23,14 @@ class BattleEvent
 	Creature* source;
 	// Creature being affected, e.g. the one being attacked
 	Creature* target;
+	// Horde that initiated the event, if it wasn't a creature
+	Horde* horde;
 	// Type of event, e.g. attack, or defense
 	BattleEventType type;
 
-	// Constructor
+	// Constructors
 	BattleEvent(Creature* source, Creature* target, BattleEventType type);
+	BattleEvent(Horde* horde, Creature* target);
 
 	// Convert the event type to the corresponding function and call it
 	// on the source and target
@@ -40,26 +47,72 @@ class Battle
 	// for use with a Dialogue
 	std::vector<Creature*> combatants;
 
+	// Hordes taking part in the fight. Their members attack together,
+	// and are only turned into combatants when the player targets them
+	std::vector<Horde*> hordes;
+
+	// Members singled out from the hordes. A list so that pointers to
+	// them stay valid as more are added
+	std::list<Creature> materialized;
+
 	// Actions that the player can take in the battle
 	Dialogue battleOptions;
 
+	// Creatures and hordes the player can attack this turn. Rebuilt every
+	// turn because some of them may die. The hordes come after the first
+	// numTargets choices, which are individual creatures
+	Dialogue targetSelection;
+	unsigned int numTargets;
+
+	// Hordes with members left, in agility order
+	std::vector<Horde*> liveHordes;
+
+	// What the player has chosen to do this turn and who to, or -1 until
+	// they have chosen
+	int action;
+	int position;
+
+	// Stream the battle is reported to
+	std::ostream& out;
+
+	// Where attacks and deaths are published, if anywhere
+	EventBus* events;
+
 	// Remove a creature from the combatants list, and report that it's dead
 	void kill(Creature* creature);
 
-	// Run the next turn for the enemies and the player.
-	// Computes what the enemies should do and asks for the player's
-	// action, then compiles an event queue of the actions before
-	// proceeding through the queue and running each action.
+	// True if any of the hordes have members left
+	bool hordesLeft();
+
+	// Get ready for the next turn, putting the combatants in order and
+	// working out who the player can target
+	void beginTurn();
+
+	// Run the next turn for the enemies and the player, once the player
+	// has chosen what to do. Computes what the enemies should do, then
+	// compiles an event queue of the actions before proceeding through
+	// the queue and running each action.
 	void nextTurn();
 
 	public:
 
 	// Constructor
-	Battle(std::vector<Creature*>& combatants);
-
-	// Run the battle until either the player dies, or all the opposing
-	// combatants do
-	void run();
+	Battle(std::vector<Creature*>& combatants,
+		std::vector<Horde*> hordes = std::vector<Horde*>(),
+		std::ostream& out = std::cout, EventBus* events = nullptr);
+
+	// The battle doesn't wait for input itself, so that whatever is running
+	// it can get on with something else whilst the player decides. Instead
+	// this returns the dialogue the player has to answer next, or nullptr
+	// once the battle is over
+	Dialogue* question();
+
+	// Give the player's answer to the question. Once they've decided what
+	// to do the turn is run
+	void answer(int choice);
+
+	// True once either the player dies, or all the opposing combatants do
+	bool over();
 };
 
 #endif /* BATTLE_HPP */
@@ -0,0 +1,154 @@
+#include <string>
+#include <cstring>
+#include <cstdint>
+
+#include "binary_io.hpp"
+
+void ByteWriter::putByte(uint8_t b)
+{
+	this->bytes.push_back(char(b));
+}
+
+void ByteWriter::putVarint(uint64_t n)
+{
+	while(n >= 0x80)
+	{
+		this->putByte(uint8_t(n) | 0x80);
+		n >>= 7;
+	}
+	this->putByte(uint8_t(n));
+}
+
+void ByteWriter::putSigned(int64_t n)
+{
+	this->putVarint((uint64_t(n) << 1) ^ uint64_t(n >> 63));
+}
+
+void ByteWriter::putFixed32(uint32_t n)
+{
+	for(int i = 0; i < 4; ++i)
+	{
+		this->putByte(uint8_t(n >> (8 * i)));
+	}
+}
+
+void ByteWriter::putDouble(double d)
+{
+	uint64_t n;
+	std::memcpy(&n, &d, sizeof(n));
+	for(int i = 0; i < 8; ++i)
+	{
+		this->putByte(uint8_t(n >> (8 * i)));
+	}
+}
+
+void ByteWriter::putString(const std::string& s)
+{
+	this->putVarint(s.size());
+	this->bytes += s;
+}
+
+uint8_t ByteReader::getByte()
+{
+	if(this->pos >= this->bytes.size())
+	{
+		this->good = false;
+		return 0;
+	}
+	return uint8_t(this->bytes[this->pos++]);
+}
+
+uint64_t ByteReader::getVarint()
+{
+	uint64_t n = 0;
+	for(int shift = 0; shift < 64; shift += 7)
+	{
+		uint8_t b = this->getByte();
+		n |= uint64_t(b & 0x7f) << shift;
+		if(!(b & 0x80)) return n;
+	}
+	// Too many bytes for a 64 bit number, so the data is corrupt
+	this->good = false;
+	return 0;
+}
+
+int64_t ByteReader::getSigned()
+{
+	uint64_t n = this->getVarint();
+	return int64_t(n >> 1) ^ -int64_t(n & 1);
+}
+
+uint32_t ByteReader::getFixed32()
+{
+	uint32_t n = 0;
+	for(int i = 0; i < 4; ++i)
+	{
+		n |= uint32_t(this->getByte()) << (8 * i);
+	}
+	return n;
+}
+
+double ByteReader::getDouble()
+{
+	uint64_t n = 0;
+	for(int i = 0; i < 8; ++i)
+	{
+		n |= uint64_t(this->getByte()) << (8 * i);
+	}
+	double d;
+	std::memcpy(&d, &n, sizeof(d));
+	return d;
+}
+
+std::string ByteReader::getString()
+{
+	uint64_t size = this->getVarint();
+	if(!this->good || size > this->bytes.size() - this->pos)
+	{
+		this->good = false;
+		return "";
+	}
+	std::string s = this->bytes.substr(this->pos, size);
+	this->pos += size;
+	return s;
+}
+
+void ByteReader::skip(size_t n)
+{
+	if(n > this->bytes.size() - this->pos)
+	{
+		this->good = false;
+		this->pos = this->bytes.size();
+	}
+	else
+	{
+		this->pos += n;
+	}
+}
+
+bool ByteReader::atEnd()
+{
+	return this->pos >= this->bytes.size();
+}
+
+size_t ByteReader::bytesLeft()
+{
+	return this->bytes.size() - this->pos;
+}
+
+ByteReader::ByteReader(const std::string& bytes) : bytes(bytes)
+{
+	this->pos = 0;
+	this->good = true;
+}
+
+uint32_t checksum(const std::string& bytes)
+{
+	uint32_t hash = 2166136261u;
+	for(char c : bytes)
+	{
+		hash ^= uint8_t(c);
+		hash *= 16777619u;
+	}
+	return hash;
+}
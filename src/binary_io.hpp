@@ -0,0 +1,75 @@
+#ifndef BINARY_IO_HPP
+#define BINARY_IO_HPP
+
+#include <string>
+#include <cstdint>
+
+// Helpers for building and reading compact binary data. Integers are
+// stored as varints, where each byte holds 7 bits of the number and the
+// top bit says whether there's another byte to come, so small numbers
+// (which most of ours are) only take up a single byte
+class ByteWriter
+{
+	public:
+
+	// The bytes written so far
+	std::string bytes;
+
+	void putByte(uint8_t b);
+
+	// Unsigned varint
+	void putVarint(uint64_t n);
+
+	// Signed varint. The sign is moved to the lowest bit (zigzag encoding)
+	// so that small negative numbers are small too
+	void putSigned(int64_t n);
+
+	// Fixed size 4 byte number, little endian
+	void putFixed32(uint32_t n);
+
+	// Doubles are stored as their raw 8 bytes, little endian
+	void putDouble(double d);
+
+	// Length prefixed string
+	void putString(const std::string& s);
+};
+
+class ByteReader
+{
+	private:
+
+	const std::string& bytes;
+
+	public:
+
+	// Position of the next byte to be read
+	size_t pos;
+
+	// Set to false if a read ran past the end of the data, after which
+	// all reads return zero
+	bool good;
+
+	uint8_t getByte();
+	uint64_t getVarint();
+	int64_t getSigned();
+	uint32_t getFixed32();
+	double getDouble();
+	std::string getString();
+
+	// Skip over n bytes
+	void skip(size_t n);
+
+	// True if every byte has been read
+	bool atEnd();
+
+	// Number of bytes that haven't been read yet
+	size_t bytesLeft();
+
+	ByteReader(const std::string& bytes);
+};
+
+// Quick checksum (FNV-1a) used to spot data that has been cut short or
+// corrupted, for example by a crash part way through writing it
+uint32_t checksum(const std::string& bytes);
+
+#endif /* BINARY_IO_HPP */
@@ -0,0 +1,271 @@
+#include <string>
+#include <vector>
+#include <unordered_map>
+#include <JsonBox.h>
+
+#include "binary_save.hpp"
+#include "binary_io.hpp"
+#include "save_data.hpp"
+
+// Type tags written before each value
+enum ValueTag { TAG_NULL, TAG_FALSE, TAG_TRUE, TAG_INTEGER, TAG_DOUBLE,
+	TAG_STRING, TAG_ARRAY, TAG_OBJECT };
+
+// Section ids
+enum SectionId { SECTION_PLAYER = 1, SECTION_AREAS = 2 };
+
+// Saves are tiny so anything nested deeper than this is corrupt
+static const int maxDepth = 64;
+
+uint64_t BinarySave::intern(const std::string& s)
+{
+	auto it = this->stringIds.find(s);
+	if(it != this->stringIds.end()) return it->second;
+
+	uint64_t id = this->strings.size();
+	this->stringIds[s] = id;
+	this->strings.push_back(s);
+
+	return id;
+}
+
+void BinarySave::encodeValue(ByteWriter& out, const JsonBox::Value& v)
+{
+	switch(v.getType())
+	{
+		case JsonBox::Value::INTEGER:
+			out.putByte(TAG_INTEGER);
+			out.putSigned(v.getInteger());
+			break;
+		case JsonBox::Value::DOUBLE:
+			out.putByte(TAG_DOUBLE);
+			out.putDouble(v.getDouble());
+			break;
+		case JsonBox::Value::BOOLEAN:
+			out.putByte(v.getBoolean() ? TAG_TRUE : TAG_FALSE);
+			break;
+		case JsonBox::Value::STRING:
+			out.putByte(TAG_STRING);
+			out.putVarint(this->intern(v.getString()));
+			break;
+		case JsonBox::Value::ARRAY:
+			out.putByte(TAG_ARRAY);
+			out.putVarint(v.getArray().size());
+			for(auto& element : v.getArray())
+			{
+				this->encodeValue(out, element);
+			}
+			break;
+		case JsonBox::Value::OBJECT:
+			out.putByte(TAG_OBJECT);
+			out.putVarint(v.getObject().size());
+			for(auto& member : v.getObject())
+			{
+				out.putVarint(this->intern(member.first));
+				this->encodeValue(out, member.second);
+			}
+			break;
+		default:
+			out.putByte(TAG_NULL);
+			break;
+	}
+
+	return;
+}
+
+void BinarySave::encodePlayer(ByteWriter& out, const JsonBox::Value& v, unsigned int fileVersion)
+{
+	if(fileVersion < 2 || v.getType() != JsonBox::Value::OBJECT)
+	{
+		this->encodeValue(out, v);
+		return;
+	}
+
+	auto empty = [](const std::pair<const std::string, JsonBox::Value>& member)
+	{
+		return member.first.compare(0, 9, "equipped_") == 0
+			&& member.second.getType() == JsonBox::Value::STRING
+			&& member.second.getString() == "nullptr";
+	};
+	uint64_t size = 0;
+	for(auto& member : v.getObject())
+	{
+		if(!empty(member)) ++size;
+	}
+	out.putByte(TAG_OBJECT);
+	out.putVarint(size);
+	for(auto& member : v.getObject())
+	{
+		if(empty(member)) continue;
+		out.putVarint(this->intern(member.first));
+		this->encodeValue(out, member.second);
+	}
+
+	return;
+}
+
+bool BinarySave::migrate(SaveData& data, uint64_t fileVersion)
+{
+	if(!data.player.isObject()) return false;
+
+	// Version 1 wrote "nullptr" for an empty equipment slot, which the
+	// player's loader still understands, but the slot is dropped so that
+	// the data looks the same as a save read from the current version
+	if(fileVersion < 2)
+	{
+		JsonBox::Object player = data.player.getObject();
+		for(auto key : {"equipped_weapon", "equipped_armor"})
+		{
+			auto it = player.find(key);
+			if(it != player.end() && it->second.isString() && it->second.getString() == "nullptr")
+				player.erase(it);
+		}
+		data.player = JsonBox::Value(player);
+	}
+
+	return true;
+}
+
+bool BinarySave::decodeValue(ByteReader& in, const std::vector<std::string>& strings,
+	JsonBox::Value& v, int depth)
+{
+	if(depth > maxDepth) return false;
+
+	switch(in.getByte())
+	{
+		case TAG_NULL:
+			v = JsonBox::Value();
+			break;
+		case TAG_FALSE:
+			v = JsonBox::Value(false);
+			break;
+		case TAG_TRUE:
+			v = JsonBox::Value(true);
+			break;
+		case TAG_INTEGER:
+			v = JsonBox::Value(int(in.getSigned()));
+			break;
+		case TAG_DOUBLE:
+			v = JsonBox::Value(in.getDouble());
+			break;
+		case TAG_STRING:
+		{
+			uint64_t id = in.getVarint();
+			if(id >= strings.size()) return false;
+			v = JsonBox::Value(strings[id]);
+			break;
+		}
+		case TAG_ARRAY:
+		{
+			// Elements are decoded straight into the array rather than
+			// being built separately and copied in
+			v = JsonBox::Value(JsonBox::Array());
+			uint64_t size = in.getVarint();
+			if(size > in.bytesLeft()) return false;
+			if(size > 0) v[size_t(size-1)] = JsonBox::Value();
+			for(size_t i = 0; i < size && in.good; ++i)
+			{
+				if(!decodeValue(in, strings, v[i], depth+1)) return false;
+			}
+			break;
+		}
+		case TAG_OBJECT:
+		{
+			v = JsonBox::Value(JsonBox::Object());
+			uint64_t size = in.getVarint();
+			for(uint64_t i = 0; i < size && in.good; ++i)
+			{
+				uint64_t key = in.getVarint();
+				if(key >= strings.size()) return false;
+				if(!decodeValue(in, strings, v[strings[key]], depth+1)) return false;
+			}
+			break;
+		}
+		default:
+			return false;
+	}
+
+	return in.good;
+}
+
+std::string BinarySave::encode(const SaveData& data, unsigned int fileVersion)
+{
+	// Snapshots taken as JSON text need parsing first
+	if(data.player.isNull() && !data.playerText.empty())
+	{
+		SaveData parsed = data;
+		parsed.parseText();
+		return encode(parsed, fileVersion);
+	}
+
+	BinarySave encoder;
+
+	// Encode the sections first so that the string table is complete
+	// by the time it needs to be written
+	ByteWriter player;
+	encoder.encodePlayer(player, data.player, fileVersion);
+	ByteWriter areas;
+	encoder.encodeValue(areas, data.areas);
+
+	ByteWriter out;
+	out.bytes = "RPGS";
+	out.putVarint(fileVersion);
+	out.putVarint(encoder.strings.size());
+	for(auto& s : encoder.strings)
+	{
+		out.putString(s);
+	}
+	out.putVarint(SECTION_PLAYER);
+	out.putString(player.bytes);
+	out.putVarint(SECTION_AREAS);
+	out.putString(areas.bytes);
+
+	return out.bytes;
+}
+
+bool BinarySave::decode(const std::string& bytes, SaveData& data)
+{
+	if(bytes.compare(0, 4, "RPGS") != 0) return false;
+
+	ByteReader in(bytes);
+	in.skip(4);
+
+	// Saves from a newer version of the game might have changed the
+	// layout in ways we can't understand
+	uint64_t fileVersion = in.getVarint();
+	if(fileVersion == 0 || fileVersion > version) return false;
+
+	std::vector<std::string> strings;
+	uint64_t numStrings = in.getVarint();
+	for(uint64_t i = 0; i < numStrings && in.good; ++i)
+	{
+		strings.push_back(in.getString());
+	}
+
+	bool havePlayer = false;
+	while(in.good && !in.atEnd())
+	{
+		uint64_t section = in.getVarint();
+		uint64_t size = in.getVarint();
+		size_t end = in.pos + size;
+		switch(section)
+		{
+			case SECTION_PLAYER:
+				if(!decodeValue(in, strings, data.player)) return false;
+				havePlayer = true;
+				break;
+			case SECTION_AREAS:
+				if(!decodeValue(in, strings, data.areas)) return false;
+				break;
+			default:
+				// Added by a newer version, so skip it
+				break;
+		}
+		if(in.pos > end) return false;
+		in.skip(end - in.pos);
+	}
+
+	data.format = SaveFormat::BINARY;
+
+	return in.good && havePlayer && migrate(data, fileVersion);
+}
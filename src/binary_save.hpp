@@ -0,0 +1,65 @@
+#ifndef BINARY_SAVE_HPP
+#define BINARY_SAVE_HPP
+
+#include <string>
+#include <vector>
+#include <unordered_map>
+#include <JsonBox.h>
+
+#include "binary_io.hpp"
+#include "save_data.hpp"
+
+// Converts saves to and from the binary format. The file starts with
+// the magic bytes "RPGS" and a format version, followed by a table of
+// every string in the save. Ids and keys are then stored as indices
+// into the table, so they're only written once. The player and area
+// data follow in sections prefixed with their id and length
+class BinarySave
+{
+	private:
+
+	// Strings seen so far when encoding, and their indices
+	std::unordered_map<std::string, uint64_t> stringIds;
+	std::vector<std::string> strings;
+
+	// Return the index of the string in the table, adding it if necessary
+	uint64_t intern(const std::string& s);
+
+	// Encode a JSON value and everything inside it
+	void encodeValue(ByteWriter& out, const JsonBox::Value& v);
+
+	// Encode the player, leaving out equipment slots with nothing in them
+	// from version 2 on
+	void encodePlayer(ByteWriter& out, const JsonBox::Value& v, unsigned int fileVersion);
+
+	// Decode a JSON value, returning false if the data is corrupt
+	static bool decodeValue(ByteReader& in, const std::vector<std::string>& strings,
+		JsonBox::Value& v, int depth = 0);
+
+	// Bring data decoded from an older version of the format up to date,
+	// applying each version's changes in turn. Returns false if it can't
+	// be
+	static bool migrate(SaveData& data, uint64_t fileVersion);
+
+	public:
+
+	// Current version of the format. Readers accept any version up to
+	// this, and only need bumping when the layout changes in a way older
+	// readers couldn't skip past. New data should go into new sections,
+	// which older readers ignore.
+	//
+	// Version 1 wrote "nullptr" for an empty equipment slot. Version 2
+	// leaves the slot out
+	static const unsigned int version = 2;
+
+	// Encode the save into the binary format. Older versions can be
+	// written too, to check that they're still read correctly
+	static std::string encode(const SaveData& data, unsigned int fileVersion = version);
+
+	// Decode a binary save into data, migrating it from older versions,
+	// returning false if it is corrupt or newer than this version of the
+	// game can read
+	static bool decode(const std::string& bytes, SaveData& data);
+};
+
+#endif /* BINARY_SAVE_HPP */
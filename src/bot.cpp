@@ -0,0 +1,141 @@
+#include <string>
+#include <vector>
+#include <random>
+
+#include "bot.hpp"
+#include "session.hpp"
+#include "player.hpp"
+#include "inventory.hpp"
+#include "item.hpp"
+#include "weapon.hpp"
+#include "armor.hpp"
+#include "area.hpp"
+#include "door.hpp"
+#include "world_overlay.hpp"
+
+// True if there's anything in the inventory at all
+static bool hasItems(Inventory& items)
+{
+	return items.get<Item>(0) != nullptr || items.get<Weapon>(0) != nullptr
+		|| items.get<Armor>(0) != nullptr;
+}
+
+int Bot::bestArmor(Session& session)
+{
+	Player& player = session.getPlayer();
+	int best = 0;
+	int defense = player.equippedArmor != nullptr ? player.equippedArmor->defense : -1;
+	Armor* armor;
+	for(unsigned int i = 0; (armor = player.inventory.get<Armor>(i)) != nullptr; ++i)
+	{
+		if(armor->defense > defense)
+		{
+			best = i+1;
+			defense = armor->defense;
+		}
+	}
+
+	return best;
+}
+
+int Bot::bestWeapon(Session& session)
+{
+	Player& player = session.getPlayer();
+	int best = 0;
+	int damage = player.equippedWeapon != nullptr ? player.equippedWeapon->damage : -1;
+	Weapon* weapon;
+	for(unsigned int i = 0; (weapon = player.inventory.get<Weapon>(i)) != nullptr; ++i)
+	{
+		if(weapon->damage > damage)
+		{
+			best = i+1;
+			damage = weapon->damage;
+		}
+	}
+
+	return best;
+}
+
+int Bot::chooseInArea(Session& session, Area* area)
+{
+	Player& player = session.getPlayer();
+	WorldOverlay& world = session.getWorld();
+
+	// The area's own choices come first, then a choice for each door,
+	// then searching and fast travel
+	int firstDoor = area->dialogue.size() + 1;
+	int search = firstDoor + area->doors.size();
+	int travel = search + 1;
+
+	// Put on anything better that's been picked up, through the menu
+	if(this->bestArmor(session) > 0 || this->bestWeapon(session) > 0) return 0;
+
+	// Pick up whatever is lying around
+	if(hasItems(area->items)) return search;
+
+	// Go somewhere new if possible, otherwise anywhere that can be reached
+	std::vector<int> unvisited;
+	std::vector<int> open;
+	for(unsigned int i = 0; i < area->doors.size(); ++i)
+	{
+		Door* door = area->doors[i];
+		if(world.locked(door) > 0 && !player.inventory.count(door->key)) continue;
+		const std::string& to = door->areas.first == player.currentArea ?
+			door->areas.second : door->areas.first;
+		if(!player.visitedAreas.count(to)) unvisited.push_back(firstDoor + i);
+		open.push_back(firstDoor + i);
+	}
+	if(!unvisited.empty())
+	{
+		return unvisited[std::uniform_int_distribution<int>(0, unvisited.size()-1)(this->gen)];
+	}
+
+	// Once everything nearby has been seen, travel somewhere else now and
+	// again so that the bot doesn't wander the same few areas forever
+	if(open.empty() || std::uniform_int_distribution<int>(0, 9)(this->gen) == 0) return travel;
+
+	return open[std::uniform_int_distribution<int>(0, open.size()-1)(this->gen)];
+}
+
+std::string Bot::answer(Session& session)
+{
+	Player& player = session.getPlayer();
+
+	switch(session.getState())
+	{
+		case SessionState::NAME:
+			return this->name;
+		case SessionState::CLASS:
+			return std::to_string(std::uniform_int_distribution<int>(1, 2)(this->gen));
+		case SessionState::AREA:
+			return std::to_string(this->chooseInArea(session, player.getAreaPtr(session.getWorld())));
+		// Go through the menu to the equipment, and equip the best of
+		// whichever is better than what's worn
+		case SessionState::MENU:
+			return this->bestArmor(session) > 0 || this->bestWeapon(session) > 0 ? "2" : "3";
+		case SessionState::EQUIPMENT:
+			if(this->bestArmor(session) > 0) return "1";
+			if(this->bestWeapon(session) > 0) return "2";
+			return "3";
+		case SessionState::EQUIP_ARMOR:
+			return std::to_string(this->bestArmor(session));
+		case SessionState::EQUIP_WEAPON:
+			return std::to_string(this->bestWeapon(session));
+		// Every other area visited is offered as a destination
+		case SessionState::TRAVEL:
+		{
+			int numDestinations = player.visitedAreas.size() > 1 ? player.visitedAreas.size()-1 : 1;
+			return std::to_string(std::uniform_int_distribution<int>(1, numDestinations)(this->gen));
+		}
+		// Attack, and attack the first enemy
+		case SessionState::BATTLE:
+			return "1";
+		default:
+			return "";
+	}
+}
+
+Bot::Bot(const std::string& name, unsigned int seed) : gen(seed)
+{
+	this->name = name;
+}
@@ -0,0 +1,43 @@
+#ifndef BOT_HPP
+#define BOT_HPP
+
+#include <string>
+#include <random>
+
+class Session;
+class Inventory;
+class Area;
+
+// Plays the game by itself, deciding what to enter by looking at the
+// session rather than by reading what it shows. It picks up everything it
+// finds, wears the best armor and weapon it has, goes through any door it
+// hasn't been through before, fast travels when it runs out of new
+// places and attacks anything it meets, so that it gets round as much of
+// the game as it can
+class Bot
+{
+	private:
+
+	std::mt19937 gen;
+
+	// Number to enter to equip the best armor or weapon in the inventory,
+	// or 0 if what's equipped is already the best
+	int bestArmor(Session& session);
+	int bestWeapon(Session& session);
+
+	// Choose something to do in the area the player is in
+	int chooseInArea(Session& session, Area* area);
+
+	public:
+
+	// Name of the player the bot plays as
+	std::string name;
+
+	// What to enter next, or an empty string once the game is over
+	std::string answer(Session& session);
+
+	// Constructor. Bots given the same seed make the same choices
+	Bot(const std::string& name, unsigned int seed);
+};
+
+#endif /* BOT_HPP */
@@ -1,5 +1,6 @@
 #include <string>
 #include <cstdlib>
+#include <algorithm>
 #include <JsonBox.h>
 
 #include "creature.hpp"
@@ -9,7 +10,10 @@
 #include "armor.hpp"
 #include "door.hpp"
 #include "area.hpp"
+#include "loot_table.hpp"
 #include "entity_manager.hpp"
+#include "json_writer.hpp"
+#include "world_overlay.hpp"
 
 Creature::Creature(std::string id, std::string name, int hp, int strength, int agility, double evasion,
 	unsigned int xp) : Entity(id)
@@ -22,6 +26,8 @@ Creature::Creature(std::string id, std::string name, int hp, int strength, int a
 	this->evasion = evasion;
 	this->equippedArmor = nullptr;
 	this->equippedWeapon = nullptr;
+	this->loot = nullptr;
+	this->movement = Movement::NONE;
 	this->xp = xp;
 }
 
@@ -45,9 +51,9 @@ void Creature::equipArmor(Armor* armor)
 	return;
 }
 
-Area* Creature::getAreaPtr(EntityManager* mgr)
+Area* Creature::getAreaPtr(WorldOverlay& world)
 {
-	return mgr->getEntity<Area>(this->currentArea);
+	return world.getArea(this->currentArea);
 }
 
 int Creature::attack(Creature* target)
@@ -69,8 +75,9 @@ int Creature::attack(Creature* target)
 		}
 		else
 		{
-			// Normal hit so factor in defense
-			int baseDamage = attack - defense / 2;
+			// Normal hit so factor in defense. Defense much greater than the
+			// attack mustn't make the range of damage negative
+			int baseDamage = std::max(0, attack - defense / 2);
 			// Do damage in range [baseDamage/4, baseDamage/2]
 			damage = baseDamage / 4 + std::rand() % (baseDamage / 4 + 1);
 			// If the damage is zero then have a 50% chance to do 1 damage
@@ -87,21 +94,22 @@ int Creature::attack(Creature* target)
 }
 
 
-int Creature::traverse(Door* door)
+int Creature::traverse(Door* door, WorldOverlay& world)
 {
 	int flag = 2;
+	int locked = world.locked(door);
 	// Open the door if it is shut
-	if(door->locked == 0)
+	if(locked == 0)
 	{
-		door->locked = -1;
+		world.setLocked(door, -1);
 		flag = 2;
 	}
-	else if(door->locked > 0)
+	else if(locked > 0)
 	{
 		// Unlock and open the door if the creature has the key
 		if(this->inventory.count(door->key))
 		{
-			door->locked = -1;
+			world.setLocked(door, -1);
 			flag = 1;
 		}
 		// Creature does not have key so door remains locked
@@ -139,6 +147,32 @@ JsonBox::Object Creature::toJson()
 	return o;
 }
 
+void Creature::writeJsonMembers(JsonWriter& out)
+{
+	out.key("name");
+	out.value(this->name);
+	out.key("hp");
+	out.value(this->hp);
+	out.key("hp_max");
+	out.value(this->maxHp);
+	out.key("strength");
+	out.value(this->strength);
+	out.key("agility");
+	out.value(this->agility);
+	out.key("evasion");
+	out.value(this->evasion);
+	out.key("xp");
+	out.value(this->xp);
+	out.key("inventory");
+	this->inventory.writeJson(out);
+	out.key("equipped_weapon");
+	out.value(this->equippedWeapon == nullptr ? "nullptr" : this->equippedWeapon->id);
+	out.key("equipped_armor");
+	out.value(this->equippedArmor == nullptr ? "nullptr" : this->equippedArmor->id);
+
+	return;
+}
+
 void Creature::load(JsonBox::Value& v, EntityManager* mgr)
 {
 	JsonBox::Object o = v.getObject();
@@ -161,6 +195,18 @@ void Creature::load(JsonBox::Value& v, EntityManager* mgr)
 	{
 		this->inventory = Inventory(o["inventory"], mgr);
 	}
+	if(o.find("loot") != o.end())
+	{
+		this->loot = mgr->getEntity<LootTable>(o["loot"].getString());
+	}
+	if(o.find("movement") != o.end())
+	{
+		std::string movement = o["movement"].getString();
+		if(movement == "wander") this->movement = Movement::WANDER;
+		else if(movement == "patrol") this->movement = Movement::PATROL;
+		else if(movement == "chase") this->movement = Movement::CHASE;
+		else this->movement = Movement::NONE;
+	}
 	if(o.find("equipped_weapon") != o.end())
 	{
 		std::string equippedWeaponName = o["equipped_weapon"].getString();
@@ -174,3 +220,23 @@ void Creature::load(JsonBox::Value& v, EntityManager* mgr)
 
 	return;
 }
+
+CreatureInstance::CreatureInstance(Creature* base)
+{
+	this->base = base;
+	this->hp = base->hp;
+	this->steps = 0;
+}
+
+const std::string& CreatureInstance::id() const
+{
+	return this->base->id;
+}
+
+Creature CreatureInstance::materialize() const
+{
+	Creature creature(*this->base);
+	creature.hp = this->hp;
+
+	return creature;
+}
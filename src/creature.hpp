@@ -7,12 +7,21 @@
 
 #include "entity.hpp"
 #include "inventory.hpp"
+#include "json_writer.hpp"
 
 class Area;
 class EntityManager;
 class Weapon;
 class Armor;
 class Door;
+class LootTable;
+class WorldOverlay;
+
+// How a creature moves around the world by itself. Wandering creatures
+// go through a random door now and again, patrolling ones go through each
+// of the doors in their area in turn, and chasing ones head for the player
+// when they're close enough
+enum class Movement { NONE, WANDER, PATROL, CHASE };
 
 class Creature : public Entity
 {
@@ -39,6 +48,13 @@ class Creature : public Entity
 	// Currently equipped armor
 	Armor* equippedArmor;
 
+	// Table rolled on for what the creature drops when it's killed, or
+	// nullptr if it doesn't drop anything
+	LootTable* loot;
+
+	// How the creature moves when it isn't fighting
+	Movement movement;
+
 	// Area the creature resides in. Used for player motion but also could
 	// be used for enemy AI
 	std::string currentArea;
@@ -57,8 +73,9 @@ class Creature : public Entity
 	// function!
 	void equipArmor(Armor* armor);
 
-	// Convert internal area id into a pointer
-	Area* getAreaPtr(EntityManager* mgr);
+	// Convert internal area id into a pointer to the area as seen
+	// through the overlay
+	Area* getAreaPtr(WorldOverlay& world);
 
 	// Attack the target creature, reducing their health if necessary
 	int attack(Creature* target);
@@ -67,13 +84,47 @@ class Creature : public Entity
 	// 0 = Door is locked
 	// 1 = Door unlocked using key
 	// 2 = Door is open
-	int traverse(Door* door);
+	// The door is opened in the overlay, not in the shared world
+	int traverse(Door* door, WorldOverlay& world);
 
 	// Create a JSON object containing the creature data
 	virtual JsonBox::Object toJson();
 
+	// Write the creature data as the members of a JSON object, giving the
+	// same JSON as toJson without building the object first
+	virtual void writeJsonMembers(JsonWriter& out);
+
 	// Attempt to load all data from the JSON value
 	virtual void load(JsonBox::Value& v, EntityManager* mgr);
 };
 
+// A creature living in an area. Everything that doesn't change during the
+// game, such as the name and stats, is shared with the other instances of
+// the same creature by pointing at the creature in the entity manager,
+// so an instance only needs to store what can change
+class CreatureInstance
+{
+	public:
+
+	// Creature in the entity manager that this is an instance of
+	Creature* base;
+
+	// Current health
+	int hp;
+
+	// Number of world ticks the instance has moved for, used to choose
+	// which door a patrolling creature goes through next
+	unsigned int steps;
+
+	// Create an instance with full health
+	CreatureInstance(Creature* base);
+
+	// Id of the base creature
+	const std::string& id() const;
+
+	// Create a complete creature with the instance's health, which can
+	// then take part in a battle
+	Creature materialize() const;
+};
+
 #endif /* CREATURE_HPP */
@@ -3,79 +3,137 @@
 
 #include <string>
 #include <vector>
+#include <memory>
+#include <functional>
 #include <iostream>
 #include <JsonBox.h>
 
 // Gameplay is expressed using dialogues, which present a piece of
 // information and some responses, and the ask the user to pick one. If
-// they do not pick a valid one then the dialogue loops until they do
+// they do not pick a valid one then the dialogue loops until they do.
+//
+// A dialogue's fixed text never changes once it's been created, so it's
+// shared between every copy of the dialogue rather than copied, and is
+// laid out ready to show as soon as it's created. Choices that depend on
+// what's going on, such as the doors out of an area, are added after the
+// fixed ones as a count and a function which writes out the choice with
+// the given number. They're only formatted when the dialogue is shown,
+// and straight onto the stream, so showing a dialogue never allocates
 class Dialogue
 {
+	public:
+
+	// Writes the nth of the extra choices, counting from 0
+	typedef std::function<void(std::ostream& out, unsigned int n)> ChoiceWriter;
+
 	private:
 
-	// Initial piece of information that the dialogue displays
-	std::string description;
+	class Text
+	{
+		public:
 
-	// A vector of choices that will be outputted. No numbering is
-	// necessary, the dialogue does that automatically
-	std::vector<std::string> choices;
+		// Initial piece of information that the dialogue displays
+		std::string description;
 
-	public:
+		// A vector of choices that will be outputted. No numbering is
+		// necessary, the dialogue does that automatically
+		std::vector<std::string> choices;
+
+		// The description and numbered choices, exactly as shown
+		std::string shown;
+
+		Text(std::string description, std::vector<std::string> choices)
+		{
+			this->description = description;
+			this->choices = choices;
+			this->shown = this->description + "\n";
+			for(unsigned int i = 0; i < this->choices.size(); ++i)
+				this->shown += std::to_string(i+1) + ": " + this->choices[i] + "\n";
+		}
+	};
+
+	std::shared_ptr<const Text> text;
+
+	// Choices that follow the fixed ones
+	unsigned int numExtra;
+	ChoiceWriter extra;
 
-	// Run the dialogue
-	int activate()
+	// Text of dialogues with nothing to say, shared so that creating one
+	// doesn't allocate
+	static const std::shared_ptr<const Text>& noText()
 	{
-		// Output the information
-		std::cout << description << std::endl;
+		static const std::shared_ptr<const Text> none(new Text("", {}));
+		return none;
+	}
 
-		// Output and number the choices
-		for(int i = 0; i < this->choices.size(); ++i)
-			std::cout << i+1 << ": " << this->choices[i] << std::endl;
+	public:
 
-		// Repeatedly read input from stdin until a valid option is
-		// chosen
-		int userInput = -1;
-		while(true)
+	// Output the information and the numbered choices
+	void show(std::ostream& out = std::cout)
+	{
+		out << this->text->shown;
+		unsigned int first = this->text->choices.size() + 1;
+		for(unsigned int i = 0; i < this->numExtra; ++i)
 		{
-			std::cin >> userInput;
-			// 'Valid' means within the range of numbers outputted
-			if(userInput >= 0 && userInput <= this->choices.size())
-			{
-				return userInput;
-			}
+			out << first + i << ": ";
+			this->extra(out, i);
+			out << "\n";
 		}
 	}
 
+	// 'Valid' means within the range of numbers outputted
+	bool valid(int choice)
+	{
+		return choice >= 0 && choice <= int(this->size());
+	}
+
 	// Note that the vector is not passed by reference. Whilst that would
 	// be more efficient, it forces us to create a vector outside of the
 	// constructor. By passing by value we can call the constructor using
 	// an initialisation list such as
 	// Dialogue my_dialogue("Hello", {"Choice1", "Choice"});
-	Dialogue(std::string description, std::vector<std::string> choices)
+	// Dialogues that are asked again and again are best created once, as
+	// statics, and copied, since copies share the text
+	Dialogue(std::string description, std::vector<std::string> choices) :
+		text(std::make_shared<const Text>(description, choices))
 	{
-		this->description = description;
-		this->choices = choices;
+		this->numExtra = 0;
 	}
 
 	// Create a dialogue from a JSON value
 	Dialogue(JsonBox::Value& v)
 	{
 		JsonBox::Object o = v.getObject();
-		description = o["description"].getString();
+		std::vector<std::string> choices;
 		for(auto choice : o["choices"].getArray())
 			choices.push_back(choice.getString());
+		this->text = std::make_shared<const Text>(o["description"].getString(), choices);
+		this->numExtra = 0;
 	}
 
-	Dialogue() {}
+	Dialogue() : text(noText())
+	{
+		this->numExtra = 0;
+	}
+
+	// Follow the fixed choices with count more, written by writer when
+	// the dialogue is shown, replacing any added before. The writer is
+	// kept, so anything it refers to must last as long as the dialogue is
+	// shown
+	void setExtraChoices(unsigned int count, ChoiceWriter writer)
+	{
+		this->numExtra = count;
+		this->extra = std::move(writer);
+	}
 
-	void addChoice(std::string choice)
+	const std::string& getDescription()
 	{
-		this->choices.push_back(choice);
+		return this->text->description;
 	}
 
 	unsigned int size()
 	{
-		return this->choices.size();
+		return this->text->choices.size() + this->numExtra;
 	}
 };
 
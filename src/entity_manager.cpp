@@ -1,5 +1,10 @@
 #include <string>
+#include <vector>
 #include <map>
+#include <atomic>
+#include <mutex>
+#include <thread>
+#include <functional>
 
 #include "entity_manager.hpp"
 #include "item.hpp"
@@ -8,19 +13,112 @@
 #include "creature.hpp"
 #include "area.hpp"
 #include "door.hpp"
+#include "loot_table.hpp"
+#include "alloc_stats.hpp"
+#include "trace.hpp"
+
+// Tag that allocations made loading entities of type T are counted under
+template <typename T>
+AllocTag entityAllocTag();
+
+// Each thread always counts itself in the same shard
+static unsigned int threadShard(unsigned int numShards)
+{
+	static thread_local unsigned int shard =
+		std::hash<std::thread::id>()(std::this_thread::get_id()) % numShards;
+
+	return shard;
+}
+
+EntityManager::ReadSection::ReadSection(EntityManager* mgr) :
+	count(mgr->shards[threadShard(numShards)].readers[mgr->phase.load() & 1])
+{
+	// Count in before looking at the index, so a writer that replaces it
+	// after this can't delete it
+	++this->count;
+	this->index = mgr->index.load();
+}
+
+EntityManager::ReadSection::~ReadSection()
+{
+	--this->count;
+}
+
+void EntityManager::synchronize()
+{
+	// Readers that started before the phase changed are counted in the
+	// old set, and no new ones join it. A reader that looked at the phase
+	// just before it changed may only count itself in afterwards, and
+	// might then have the index before the one just replaced, so wait for
+	// both sets to empty in turn
+	for(int i = 0; i < 2; ++i)
+	{
+		unsigned int old = this->phase.fetch_add(1) & 1;
+		for(unsigned int shard = 0; shard < numShards; ++shard)
+		{
+			while(this->shards[shard].readers[old].load() != 0)
+			{
+				std::this_thread::yield();
+			}
+		}
+	}
+
+	return;
+}
+
+void EntityManager::publish(Index* fresh)
+{
+	Index* old = this->index.exchange(fresh);
+	this->synchronize();
+	delete old;
+
+	return;
+}
 
 template <class T>
 void EntityManager::loadJson(std::string filename)
 {
+	TRACE_SCOPE("EntityManager::loadJson");
+
+	ALLOC_SCOPE(entityAllocTag<T>());
+
 	JsonBox::Value v;
 	v.loadFromFile(filename);
 
+	std::lock_guard<std::mutex> lock(this->writeMutex);
+
+	// Entities can only refer to ones that were loaded before them, so the
+	// whole file can be published at once
+	Index* fresh;
+	{
+		// The index isn't part of any one type's footprint
+		ALLOC_SCOPE(AllocTag::OTHER);
+		fresh = new Index(*this->index.load());
+	}
 	JsonBox::Object o = v.getObject();
 	for(auto entity : o)
 	{
 		std::string key = entity.first;
-		this->data[key] = dynamic_cast<Entity*>(new T(key, entity.second, this));
+		Entity* loaded = dynamic_cast<Entity*>(new T(key, entity.second, this));
+		ALLOC_SCOPE(AllocTag::OTHER);
+		Entity*& slot = (*fresh)[key];
+		if(slot != nullptr) this->replaced.push_back(slot);
+		slot = loaded;
 	}
+	this->publish(fresh);
+}
+
+void EntityManager::addEntity(Entity* entity)
+{
+	std::lock_guard<std::mutex> lock(this->writeMutex);
+
+	Index* fresh = new Index(*this->index.load());
+	Entity*& slot = (*fresh)[entity->id];
+	if(slot != nullptr) this->replaced.push_back(slot);
+	slot = entity;
+	this->publish(fresh);
+
+	return;
 }
 
 template <class T>
@@ -30,19 +128,76 @@ T* EntityManager::getEntity(std::string id)
 	// first characters of the id up to the length of the
 	// prefix and compare the two
 	if(id.substr(0, entityToString<T>().size()) == entityToString<T>())
-		return dynamic_cast<T*>(this->data.at(id));
+	{
+		ReadSection section(this);
+		return dynamic_cast<T*>(section.index->at(id));
+	}
 	else
 		return nullptr;
 }
 
-EntityManager::EntityManager() {}
+template <class T>
+T* EntityManager::findEntity(std::string id)
+{
+	if(id.substr(0, entityToString<T>().size()) != entityToString<T>()) return nullptr;
+
+	ReadSection section(this);
+	auto it = section.index->find(id);
+	if(it == section.index->end()) return nullptr;
+
+	return dynamic_cast<T*>(it->second);
+}
+
+Item* EntityManager::getItem(std::string id)
+{
+	// Weapons and armor are items too, so the id prefix can't be used
+	ReadSection section(this);
+	auto it = section.index->find(id);
+	if(it == section.index->end()) return nullptr;
+
+	return dynamic_cast<Item*>(it->second);
+}
+
+template <class T>
+std::vector<T*> EntityManager::getEntities()
+{
+	// Ids are sorted so all the entities of one type are next to each
+	// other, starting from the first id with the right prefix
+	std::string prefix = entityToString<T>();
+	std::vector<T*> entities;
+	ReadSection section(this);
+	for(auto it = section.index->lower_bound(prefix); it != section.index->end(); ++it)
+	{
+		if(it->first.compare(0, prefix.size(), prefix) != 0) break;
+		entities.push_back(dynamic_cast<T*>(it->second));
+	}
+
+	return entities;
+}
+
+EntityManager::EntityManager()
+{
+	this->index = new Index;
+	this->phase = 0;
+	for(auto& shard : this->shards)
+	{
+		shard.readers[0] = 0;
+		shard.readers[1] = 0;
+	}
+}
 
 EntityManager::~EntityManager()
 {
-	for(auto& entity : this->data)
+	Index* index = this->index.load();
+	for(auto& entity : *index)
 	{
 		delete entity.second;
 	}
+	for(auto entity : this->replaced)
+	{
+		delete entity;
+	}
+	delete index;
 }
 
 // Template specialisations
@@ -52,6 +207,41 @@ template <> std::string entityToString<Armor>() { return "armor"; }
 template <> std::string entityToString<Creature>() { return "creature"; }
 template <> std::string entityToString<Area>() { return "area"; }
 template <> std::string entityToString<Door>() { return "door"; }
+template <> std::string entityToString<LootTable>() { return "loot"; }
+
+template <> AllocTag entityAllocTag<Item>() { return AllocTag::ITEM; }
+template <> AllocTag entityAllocTag<Weapon>() { return AllocTag::WEAPON; }
+template <> AllocTag entityAllocTag<Armor>() { return AllocTag::ARMOR; }
+template <> AllocTag entityAllocTag<Creature>() { return AllocTag::CREATURE; }
+template <> AllocTag entityAllocTag<Area>() { return AllocTag::AREA; }
+template <> AllocTag entityAllocTag<Door>() { return AllocTag::DOOR; }
+template <> AllocTag entityAllocTag<LootTable>() { return AllocTag::LOOT; }
+
+// Needs the specialisations above
+template <class T>
+static void reportEntities(EntityManager* mgr, std::ostream& out)
+{
+	out << entityToString<T>() << ": " << mgr->getEntities<T>().size() << " loaded";
+#ifdef RPG_ALLOC_STATS
+	out << ", " << AllocStats::get(entityAllocTag<T>()).live << " bytes";
+#endif
+	out << std::endl;
+
+	return;
+}
+
+void EntityManager::memoryReport(std::ostream& out)
+{
+	reportEntities<Item>(this, out);
+	reportEntities<Weapon>(this, out);
+	reportEntities<Armor>(this, out);
+	reportEntities<LootTable>(this, out);
+	reportEntities<Creature>(this, out);
+	reportEntities<Door>(this, out);
+	reportEntities<Area>(this, out);
+
+	return;
+}
 
 // Template instantiations
 template void EntityManager::loadJson<Item>(std::string);
@@ -60,6 +250,7 @@ template void EntityManager::loadJson<Armor>(std::string);
 template void EntityManager::loadJson<Creature>(std::string);
 template void EntityManager::loadJson<Area>(std::string);
 template void EntityManager::loadJson<Door>(std::string);
+template void EntityManager::loadJson<LootTable>(std::string);
 
 template Item* EntityManager::getEntity<Item>(std::string);
 template Weapon* EntityManager::getEntity<Weapon>(std::string);
@@ -67,4 +258,21 @@ template Armor* EntityManager::getEntity<Armor>(std::string);
 template Creature* EntityManager::getEntity<Creature>(std::string);
 template Area* EntityManager::getEntity<Area>(std::string);
 template Door* EntityManager::getEntity<Door>(std::string);
+template LootTable* EntityManager::getEntity<LootTable>(std::string);
+
+template Item* EntityManager::findEntity<Item>(std::string);
+template Weapon* EntityManager::findEntity<Weapon>(std::string);
+template Armor* EntityManager::findEntity<Armor>(std::string);
+template Creature* EntityManager::findEntity<Creature>(std::string);
+template Area* EntityManager::findEntity<Area>(std::string);
+template Door* EntityManager::findEntity<Door>(std::string);
+template LootTable* EntityManager::findEntity<LootTable>(std::string);
+
+template std::vector<Item*> EntityManager::getEntities<Item>();
+template std::vector<Weapon*> EntityManager::getEntities<Weapon>();
+template std::vector<Armor*> EntityManager::getEntities<Armor>();
+template std::vector<Creature*> EntityManager::getEntities<Creature>();
+template std::vector<Area*> EntityManager::getEntities<Area>();
+template std::vector<Door*> EntityManager::getEntities<Door>();
+template std::vector<LootTable*> EntityManager::getEntities<LootTable>();
 
@@ -2,15 +2,84 @@
 #define ENTITY_MANAGER_HPP
 
 #include <string>
+#include <vector>
 #include <map>
+#include <iostream>
+#include <atomic>
+#include <mutex>
 
 #include "entity.hpp"
 
+class Item;
+
+// Holds every entity, looked up by id. Lots of threads read from it at
+// once (sessions, battles and the world sim) whilst it can occasionally be
+// changed, for example to load more content.
+//
+// Readers never lock. The index from ids to entities is never changed
+// once it's been published; instead a writer copies it, changes the copy
+// and swaps it in with an atomic store. Readers count themselves in and
+// out of the index they're using, and the old index is only deleted once
+// every reader that might have seen it has finished. The counts are split
+// across several cache lines so readers on different threads don't fight
+// over the same one, and they're kept in two sets, so that a writer only
+// waits for the readers that started before it rather than for a gap in
+// a steady stream of them
 class EntityManager
 {
 	private:
 
-	std::map<std::string, Entity*> data;
+	typedef std::map<std::string, Entity*> Index;
+
+	// Number of reader counts, each on its own cache line
+	static const unsigned int numShards = 64;
+
+	class Shard
+	{
+		public:
+
+		std::atomic<long> readers[2];
+		char padding[64];
+	};
+
+	// Marks a reader as using the index for as long as it exists
+	class ReadSection
+	{
+		private:
+
+		std::atomic<long>& count;
+
+		public:
+
+		const Index* index;
+
+		ReadSection(EntityManager* mgr);
+		~ReadSection();
+	};
+
+	// The current index
+	std::atomic<Index*> index;
+
+	// Which set of counts new readers add themselves to
+	std::atomic<unsigned int> phase;
+
+	Shard shards[numShards];
+
+	// Entities that have been replaced by a newer version. The game keeps
+	// pointers to entities for a long time, so these are kept until the
+	// manager is destroyed
+	std::vector<Entity*> replaced;
+
+	// Only one writer at a time
+	std::mutex writeMutex;
+
+	// Wait until every reader that could be using an index that has been
+	// replaced is done with it
+	void synchronize();
+
+	// Swap in the new index, then delete the old one once it's safe.
+	// Must be called with the write mutex held
+	void publish(Index* fresh);
 
 	public:
 
@@ -19,10 +88,31 @@ class EntityManager
 	template<typename T>
 	void loadJson(std::string filename);
 
+	// Add an entity, replacing any with the same id. The manager takes
+	// ownership of it
+	void addEntity(Entity* entity);
+
 	// Return the entity given by id
 	template<typename T>
 	T* getEntity(std::string id);
 
+	// Return the entity given by id, or nullptr if there isn't one, such
+	// as when a save refers to something since removed from the content
+	template<typename T>
+	T* findEntity(std::string id);
+
+	// Return the item, weapon or armor given by id, or nullptr if there
+	// isn't one
+	Item* getItem(std::string id);
+
+	// Return every entity of type T, in order of id
+	template<typename T>
+	std::vector<T*> getEntities();
+
+	// Write the number of each type of entity, and how much memory loading
+	// them left in use if allocations are being counted
+	void memoryReport(std::ostream& out);
+
 	// Constructor
 	EntityManager();
 
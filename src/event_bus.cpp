@@ -0,0 +1,163 @@
+#include <string>
+#include <algorithm>
+#include <functional>
+#include <thread>
+#include <chrono>
+#include <atomic>
+#include <cstring>
+
+#include "event_bus.hpp"
+
+// Copy a string into a fixed size name, cutting it short if needed
+static void copyName(char* dest, std::size_t size, const std::string& src)
+{
+	std::size_t n = std::min(src.size(), size - 1);
+	std::memcpy(dest, src.data(), n);
+	dest[n] = '\0';
+
+	return;
+}
+
+GameEvent::GameEvent(GameEventType type, const std::string& source,
+	const std::string& target, long value)
+{
+	this->type = type;
+	copyName(this->source, sizeof(this->source), source);
+	copyName(this->target, sizeof(this->target), target);
+	this->value = value;
+}
+
+std::string GameEvent::str() const
+{
+	std::string source = this->source;
+	std::string target = this->target;
+	std::string value = std::to_string(this->value);
+	switch(this->type)
+	{
+		case GameEventType::ATTACK:
+			return source + " attacks " + target + " for " + value + " damage!";
+		case GameEventType::SLAIN:
+			return source + " is slain!";
+		case GameEventType::LEVEL_UP:
+			return source + " grew to level " + value + "!";
+		case GameEventType::FIND:
+			return source + " finds " + target + " x" + value;
+		case GameEventType::VICTORY:
+			return source + " gained " + value + " experience!";
+		case GameEventType::DEATH:
+			return source + " died";
+		default:
+			return source;
+	}
+}
+
+void EventBus::consume(Subscriber* subscriber)
+{
+	unsigned long long cursor = subscriber->cursor.load();
+	while(true)
+	{
+		Slot& slot = this->slots[cursor & (this->capacity - 1)];
+		if(slot.sequence.load(std::memory_order_acquire) == cursor + 1)
+		{
+			subscriber->handler(slot.event);
+			// Only now can a publisher reuse the slot
+			subscriber->cursor.store(++cursor, std::memory_order_release);
+			continue;
+		}
+
+		// Once stopping, finish when every event claimed has been handled.
+		// Nothing is published after the bus starts being destroyed
+		if(this->stopping.load() && cursor >= this->claimed.load()) break;
+
+		// Nothing to do, so don't keep a core busy waiting
+		std::this_thread::sleep_for(std::chrono::milliseconds(1));
+	}
+
+	return;
+}
+
+void EventBus::subscribe(std::function<void(const GameEvent&)> handler)
+{
+	std::unique_ptr<Subscriber> subscriber(new Subscriber);
+	subscriber->handler = handler;
+	subscriber->cursor = 0;
+	this->subscribers.push_back(std::move(subscriber));
+
+	return;
+}
+
+void EventBus::start()
+{
+	for(auto& subscriber : this->subscribers)
+	{
+		subscriber->thread = std::thread(&EventBus::consume, this, subscriber.get());
+	}
+	this->running = !this->subscribers.empty();
+
+	return;
+}
+
+bool EventBus::publish(const GameEvent& event)
+{
+	// Without any subscribers there's no one to tell
+	if(!this->running.load(std::memory_order_relaxed)) return false;
+
+	unsigned long long sequence = this->claimed.load();
+	do
+	{
+		// The slot can't be reused until every subscriber has read the
+		// event a whole ring before this one
+		if(sequence >= this->gate.load() + this->capacity)
+		{
+			unsigned long long slowest = sequence;
+			for(auto& subscriber : this->subscribers)
+			{
+				slowest = std::min(slowest, subscriber->cursor.load(std::memory_order_acquire));
+			}
+			this->gate.store(slowest);
+			if(sequence >= slowest + this->capacity)
+			{
+				++this->dropped;
+				return false;
+			}
+		}
+	}
+	while(!this->claimed.compare_exchange_weak(sequence, sequence + 1));
+
+	Slot& slot = this->slots[sequence & (this->capacity - 1)];
+	slot.event = event;
+	slot.sequence.store(sequence + 1, std::memory_order_release);
+
+	return true;
+}
+
+unsigned long long EventBus::numDropped()
+{
+	return this->dropped.load();
+}
+
+EventBus::EventBus(unsigned int capacity)
+{
+	this->capacity = 1;
+	while(this->capacity < capacity) this->capacity *= 2;
+	this->slots.reset(new Slot[this->capacity]);
+	for(unsigned long long i = 0; i < this->capacity; ++i)
+	{
+		this->slots[i].sequence = 0;
+	}
+	this->claimed = 0;
+	this->gate = 0;
+	this->dropped = 0;
+	this->running = false;
+	this->stopping = false;
+}
+
+EventBus::~EventBus()
+{
+	this->running = false;
+	this->stopping = true;
+	for(auto& subscriber : this->subscribers)
+	{
+		if(subscriber->thread.joinable()) subscriber->thread.join();
+	}
+}
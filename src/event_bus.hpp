@@ -0,0 +1,124 @@
+#ifndef EVENT_BUS_HPP
+#define EVENT_BUS_HPP
+
+#include <string>
+#include <vector>
+#include <memory>
+#include <functional>
+#include <thread>
+#include <atomic>
+
+// Things that can happen in the game that something other than the
+// player might want to know about
+enum class GameEventType { ATTACK, SLAIN, LEVEL_UP, FIND, VICTORY, DEATH };
+
+// A record of something that happened. Events are copied into the bus
+// and read from other threads, so they don't point to anything that
+// might change or be freed in the meantime. Names that don't fit are cut
+// short
+class GameEvent
+{
+	public:
+
+	GameEventType type;
+
+	// Whoever or whatever did it, e.g. the attacker, or the player who
+	// found an item
+	char source[48];
+	// Whoever or whatever it was done to, e.g. the creature attacked or
+	// the id of the item found
+	char target[48];
+	// Damage done, level reached, number of items found or experience
+	// gained
+	long value;
+
+	// Describe the event in the same words the game uses
+	std::string str() const;
+
+	// Constructors
+	GameEvent(GameEventType type, const std::string& source,
+		const std::string& target = "", long value = 0);
+	GameEvent() {}
+};
+
+// Passes events from the game to subscribers, such as logging or
+// statistics, which each handle them on their own thread.
+//
+// Events go into a fixed size ring. Publishers claim the next place in
+// the ring with a compare and swap, copy the event in and mark it as
+// written, so they never lock or wait. Each subscriber keeps its own
+// position in the ring and reads every event in order. A publisher only
+// checks where the slowest subscriber is when it's about to catch up with
+// it, so the number of subscribers doesn't slow publishing down. If the
+// ring is full the event is dropped rather than holding up the game
+class EventBus
+{
+	private:
+
+	// A place in the ring. The sequence is one more than the number of the
+	// event in it, once it's been written
+	class Slot
+	{
+		public:
+
+		std::atomic<unsigned long long> sequence;
+		GameEvent event;
+	};
+
+	class Subscriber
+	{
+		public:
+
+		std::function<void(const GameEvent&)> handler;
+
+		// Number of the next event to handle
+		std::atomic<unsigned long long> cursor;
+
+		std::thread thread;
+	};
+
+	std::unique_ptr<Slot[]> slots;
+	unsigned long long capacity;
+
+	// Number of the next event to be published
+	std::atomic<unsigned long long> claimed;
+
+	// No subscriber is behind this event. Only worked out again when a
+	// publisher gets a whole ring ahead of it
+	std::atomic<unsigned long long> gate;
+
+	std::vector<std::unique_ptr<Subscriber>> subscribers;
+
+	std::atomic<unsigned long long> dropped;
+	std::atomic<bool> running;
+	std::atomic<bool> stopping;
+
+	// Body of each subscriber's thread
+	void consume(Subscriber* subscriber);
+
+	public:
+
+	// Add a subscriber, which will be called with every event on a thread
+	// of its own. Must be done before starting the bus
+	void subscribe(std::function<void(const GameEvent&)> handler);
+
+	// Start the subscribers' threads
+	void start();
+
+	// Pass an event to every subscriber. Returns false if the ring was
+	// full and the event was dropped. Does nothing until the bus has been
+	// started
+	bool publish(const GameEvent& event);
+
+	// Number of events dropped because a subscriber couldn't keep up
+	unsigned long long numDropped();
+
+	// Constructor. The capacity is rounded up to a power of two
+	EventBus(unsigned int capacity = 4096);
+
+	// Destructor. Lets the subscribers handle every event published, then
+	// stops them
+	~EventBus();
+};
+
+#endif /* EVENT_BUS_HPP */
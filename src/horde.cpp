@@ -0,0 +1,95 @@
+#include <string>
+#include <random>
+#include <cmath>
+#include <cstdlib>
+#include <algorithm>
+
+#include "horde.hpp"
+#include "creature.hpp"
+#include "weapon.hpp"
+#include "armor.hpp"
+
+// Total of count random numbers each picked uniformly from [low, low+range].
+// Small totals are added up one at a time, larger ones are close enough
+// to a normal distribution that they can be picked from that instead
+static int sumUniform(std::minstd_rand& gen, unsigned int count, int low, int range)
+{
+	if(count == 0) return 0;
+	if(count < 16)
+	{
+		int total = 0;
+		std::uniform_int_distribution<int> dist(low, low + range);
+		for(unsigned int i = 0; i < count; ++i) total += dist(gen);
+		return total;
+	}
+	double mean = count * (low + range / 2.0);
+	double variance = count * ((range + 1.0) * (range + 1.0) - 1.0) / 12.0;
+	std::normal_distribution<double> normal(mean, std::sqrt(variance));
+	double total = std::round(normal(gen));
+
+	// Keep the total within what the members could actually do
+	total = std::max(total, double(count) * low);
+	total = std::min(total, double(count) * (low + range));
+	return int(total);
+}
+
+Horde::Horde(Creature* base, unsigned int count)
+{
+	this->base = base;
+	this->count = count;
+}
+
+std::string Horde::name()
+{
+	return this->base->name + " horde (" + std::to_string(this->count) + ")";
+}
+
+int Horde::attack(Creature* target)
+{
+	if(this->count == 0) return 0;
+
+	// Seed from rand() so that seeding the game seeds hordes too
+	std::minstd_rand gen(std::rand());
+
+	// Each member follows the same rules as Creature::attack, so first
+	// find how many members get past the target's evasion, and how many
+	// of those land critical hits
+	std::binomial_distribution<unsigned int> hitDist(this->count, 1.0 - target->evasion);
+	unsigned int hits = hitDist(gen);
+	std::binomial_distribution<unsigned int> critDist(hits, 1.0 / 32.0);
+	unsigned int crits = critDist(gen);
+	unsigned int normalHits = hits - crits;
+
+	int attack = this->base->strength +
+		(this->base->equippedWeapon == nullptr ? 0 : this->base->equippedWeapon->damage);
+	int defense = target->agility +
+		(target->equippedArmor == nullptr ? 0 : target->equippedArmor->defense);
+
+	// Critical hits ignore defense
+	int damage = sumUniform(gen, crits, attack / 2, attack / 2);
+
+	// Normal hits that would do no damage have a 50% chance to do 1 damage
+	// instead, otherwise they always do at least 1
+	int baseDamage = attack - defense / 2;
+	if(baseDamage / 4 < 1)
+	{
+		std::binomial_distribution<unsigned int> coinDist(normalHits, 0.5);
+		damage += coinDist(gen);
+	}
+	else
+	{
+		damage += sumUniform(gen, normalHits, baseDamage / 4, baseDamage / 4);
+	}
+
+	target->hp -= damage;
+
+	return damage;
+}
+
+Creature Horde::materialize()
+{
+	Creature creature(*this->base);
+	if(this->count > 0) --this->count;
+
+	return creature;
+}
@@ -0,0 +1,40 @@
+#ifndef HORDE_HPP
+#define HORDE_HPP
+
+#include <string>
+
+class Creature;
+
+// A large group of identical creatures, such as a swarm of rats. Rather
+// than storing every member the horde just stores which creature they
+// all are and how many of them there are. Members are always at full
+// health whilst they're part of the horde, because the only way to hurt
+// one is to single it out in a battle, at which point it's taken out of
+// the horde and becomes an ordinary creature
+class Horde
+{
+	public:
+
+	// Creature in the entity manager that every member is a copy of
+	Creature* base;
+
+	// Number of members left
+	unsigned int count;
+
+	// Constructor
+	Horde(Creature* base, unsigned int count);
+
+	// Name shown to the player, e.g. Rat horde (200)
+	std::string name();
+
+	// Every member attacks the target at once. The total damage is
+	// worked out from the number of members in one go, so it takes the
+	// same time however big the horde is. Returns the total damage done
+	int attack(Creature* target);
+
+	// Take a member out of the horde, returning it as a complete
+	// creature so that it can be fought on its own
+	Creature materialize();
+};
+
+#endif /* HORDE_HPP */
@@ -9,6 +9,8 @@
 #include "weapon.hpp"
 #include "armor.hpp"
 #include "entity_manager.hpp"
+#include "trace.hpp"
+#include "alloc_stats.hpp"
 
 template <typename T>
 void Inventory::load(JsonBox::Value& v, EntityManager* mgr)
@@ -40,8 +42,90 @@ JsonBox::Array Inventory::jsonArray()
 	return a;
 }
 
+template <typename T, typename F>
+void Inventory::forEachDelta(Inventory& base, F f)
+{
+	// Items that have been added, or whose quantity has changed
+	for(auto item : this->items)
+	{
+		if(item.first->id.substr(0, entityToString<T>().size()) != entityToString<T>())
+			continue;
+		int change = item.second - base.count(item.first);
+		if(change != 0) f(item.first, change);
+	}
+	// Items that have been removed entirely
+	for(auto item : base.items)
+	{
+		if(item.first->id.substr(0, entityToString<T>().size()) != entityToString<T>())
+			continue;
+		if(this->count(item.first) == 0) f(item.first, -item.second);
+	}
+}
+
+template <typename T>
+JsonBox::Array Inventory::jsonDeltaArray(Inventory& base)
+{
+	JsonBox::Array a;
+	this->forEachDelta<T>(base, [&a](Item* item, int change)
+	{
+		JsonBox::Array pair;
+		pair.push_back(JsonBox::Value(item->id));
+		pair.push_back(JsonBox::Value(change));
+		a.push_back(JsonBox::Value(pair));
+	});
+
+	return a;
+}
+
+template <typename T>
+void Inventory::writeJsonArray(JsonWriter& out)
+{
+	out.beginArray();
+	for(auto& item : this->items)
+	{
+		if(item.first->id.compare(0, entityToString<T>().size(), entityToString<T>()) != 0)
+			continue;
+		out.beginArray();
+		out.value(item.first->id);
+		out.value(item.second);
+		out.endArray();
+	}
+	out.endArray();
+}
+
+template <typename T>
+void Inventory::writeJsonDeltaArray(JsonWriter& out, Inventory& base)
+{
+	out.beginArray();
+	this->forEachDelta<T>(base, [&out](Item* item, int change)
+	{
+		out.beginArray();
+		out.value(item->id);
+		out.value(change);
+		out.endArray();
+	});
+	out.endArray();
+}
+
+template <typename T>
+void Inventory::applyDelta(JsonBox::Value& v, EntityManager* mgr)
+{
+	for(auto item : v.getArray())
+	{
+		T* entity = mgr->getEntity<T>(item.getArray()[0].getString());
+		int change = item.getArray()[1].getInteger();
+		if(change > 0)
+			this->add(entity, change);
+		else
+			this->remove(entity, -change);
+	}
+}
+
 void Inventory::add(Item* item, int count)
 {
+	TRACE_SCOPE("Inventory::add");
+	ALLOC_SCOPE(AllocTag::INVENTORY);
+
 	for(auto& it : this->items)
 	{
 		if(it.first->id == item->id)
@@ -55,6 +139,9 @@ void Inventory::add(Item* item, int count)
 
 void Inventory::remove(Item* item, int count)
 {
+	TRACE_SCOPE("Inventory::remove");
+	ALLOC_SCOPE(AllocTag::INVENTORY);
+
 	// Iterate through the items, and if they are found then decrease
 	// the quantity by the quantity removed
 	for(auto it = this->items.begin(); it != this->items.end(); ++it)
@@ -104,7 +191,7 @@ int Inventory::count(unsigned int n)
 }
 
 template <typename T>
-int Inventory::print(bool label)
+int Inventory::print(bool label, std::ostream& out)
 {
 	unsigned int i = 1;
 
@@ -114,11 +201,11 @@ int Inventory::print(bool label)
 		if(it.first->id.substr(0, entityToString<T>().size()) != entityToString<T>())
 			continue;
 		// Number the items if asked
-		if(label) std::cout << i++ << ": ";
+		if(label) out << i++ << ": ";
 		// Output the item name, quantity and description, e.g.
 		// Gold Piece (29) - Glimmering discs of wealth
-		std::cout << it.first->name << " (" << it.second << ") - ";
-		std::cout << it.first->description << std::endl;
+		out << it.first->name << " (" << it.second << ") - ";
+		out << it.first->description << "\n";
 	}
 
 	// Return the number of items outputted, for convenience
@@ -126,19 +213,21 @@ int Inventory::print(bool label)
 }
 
 // Overload of print to print all items when the template argument is empty
-int Inventory::print(bool label)
+int Inventory::print(bool label, std::ostream& out)
 {
+	ALLOC_SCOPE(AllocTag::INVENTORY);
+
 	unsigned int i = 0;
 
 	if(items.empty())
 	{
-		std::cout << "Nothing" << std::endl;
+		out << "Nothing\n";
 	}
 	else
 	{
-		i += print<Item>(label);
-		i += print<Weapon>(label);
-		i += print<Armor>(label);
+		i += print<Item>(label, out);
+		i += print<Weapon>(label, out);
+		i += print<Armor>(label, out);
 	}
 
 	return i;
@@ -151,6 +240,9 @@ void Inventory::clear()
 
 void Inventory::merge(Inventory* inventory)
 {
+	TRACE_SCOPE("Inventory::merge");
+	ALLOC_SCOPE(AllocTag::INVENTORY);
+
 	// You can't merge an inventory with itself!
 	if(inventory == this) return;
 
@@ -180,6 +272,69 @@ JsonBox::Object Inventory::getJson()
 	return o;
 }
 
+JsonBox::Object Inventory::getJsonDelta(Inventory& base)
+{
+	JsonBox::Object o;
+
+	JsonBox::Array items = jsonDeltaArray<Item>(base);
+	JsonBox::Array weapons = jsonDeltaArray<Weapon>(base);
+	JsonBox::Array armor = jsonDeltaArray<Armor>(base);
+	if(!items.empty()) o["items"] = JsonBox::Value(items);
+	if(!weapons.empty()) o["weapons"] = JsonBox::Value(weapons);
+	if(!armor.empty()) o["armor"] = JsonBox::Value(armor);
+
+	return o;
+}
+
+void Inventory::loadDelta(JsonBox::Value& v, EntityManager* mgr)
+{
+	JsonBox::Object o = v.getObject();
+	applyDelta<Item>(o["items"], mgr);
+	applyDelta<Weapon>(o["weapons"], mgr);
+	applyDelta<Armor>(o["armor"], mgr);
+}
+
+unsigned int Inventory::deltaSize(Inventory& base)
+{
+	unsigned int size = 0;
+	auto counter = [&size](Item*, int) { ++size; };
+	this->forEachDelta<Item>(base, counter);
+	this->forEachDelta<Weapon>(base, counter);
+	this->forEachDelta<Armor>(base, counter);
+
+	return size;
+}
+
+void Inventory::writeJson(JsonWriter& out)
+{
+	TRACE_SCOPE("Inventory::writeJson");
+
+	out.beginObject();
+	out.key("items");
+	this->writeJsonArray<Item>(out);
+	out.key("weapons");
+	this->writeJsonArray<Weapon>(out);
+	out.key("armor");
+	this->writeJsonArray<Armor>(out);
+	out.endObject();
+}
+
+void Inventory::writeJsonDelta(JsonWriter& out, Inventory& base)
+{
+	TRACE_SCOPE("Inventory::writeJsonDelta");
+
+	// Unlike getJsonDelta, types with no changes are written as empty
+	// arrays; they load the same way
+	out.beginObject();
+	out.key("items");
+	this->writeJsonDeltaArray<Item>(out, base);
+	out.key("weapons");
+	this->writeJsonDeltaArray<Weapon>(out, base);
+	out.key("armor");
+	this->writeJsonDeltaArray<Armor>(out, base);
+	out.endObject();
+}
+
 // Template instantiations
 template void Inventory::load<Item>(JsonBox::Value&, EntityManager*);
 template void Inventory::load<Weapon>(JsonBox::Value&, EntityManager*);
@@ -189,6 +344,14 @@ template JsonBox::Array Inventory::jsonArray<Item>();
 template JsonBox::Array Inventory::jsonArray<Weapon>();
 template JsonBox::Array Inventory::jsonArray<Armor>();
 
+template JsonBox::Array Inventory::jsonDeltaArray<Item>(Inventory&);
+template JsonBox::Array Inventory::jsonDeltaArray<Weapon>(Inventory&);
+template JsonBox::Array Inventory::jsonDeltaArray<Armor>(Inventory&);
+
+template void Inventory::applyDelta<Item>(JsonBox::Value&, EntityManager*);
+template void Inventory::applyDelta<Weapon>(JsonBox::Value&, EntityManager*);
+template void Inventory::applyDelta<Armor>(JsonBox::Value&, EntityManager*);
+
 template int Inventory::count<Item>(unsigned int);
 template int Inventory::count<Weapon>(unsigned int);
 template int Inventory::count<Armor>(unsigned int);
@@ -197,6 +360,6 @@ template Item* Inventory::get<Item>(unsigned int);
 template Weapon* Inventory::get<Weapon>(unsigned int);
 template Armor* Inventory::get<Armor>(unsigned int);
 
-template int Inventory::print<Item>(bool);
-template int Inventory::print<Weapon>(bool);
-template int Inventory::print<Armor>(bool);
+template int Inventory::print<Item>(bool, std::ostream&);
+template int Inventory::print<Weapon>(bool, std::ostream&);
+template int Inventory::print<Armor>(bool, std::ostream&);
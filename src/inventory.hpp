@@ -3,9 +3,11 @@
 
 #include <list>
 #include <utility>
+#include <iostream>
 #include <JsonBox.h>
 
 #include "entity_manager.hpp"
+#include "json_writer.hpp"
 
 class Item;
 class Weapon;
@@ -31,6 +33,27 @@ class Inventory
 	template <typename T>
 	JsonBox::Array jsonArray();
 
+	// Return a JSON representation of how the quantities of the items of
+	// type T differ from those in the base inventory
+	template <typename T>
+	JsonBox::Array jsonDeltaArray(Inventory& base);
+
+	// Call f(item, change) for every item of type T whose quantity differs
+	// from that in the base inventory
+	template <typename T, typename F>
+	void forEachDelta(Inventory& base, F f);
+
+	// Write the items of type T, or the changes to them, as a JSON array
+	template <typename T>
+	void writeJsonArray(JsonWriter& out);
+	template <typename T>
+	void writeJsonDeltaArray(JsonWriter& out, Inventory& base);
+
+	// Given the Json value v which contains a list of quantity changes for
+	// items of type T, add them to (or remove them from) the inventory
+	template <typename T>
+	void applyDelta(JsonBox::Value& v, EntityManager* mgr);
+
 	public:
 
 	// Add an item to the inventory
@@ -48,10 +71,10 @@ class Inventory
 	template <typename T>
 	T* get(unsigned int n);
 
-	// Output a list of the items onto stdout, formatted nicely and
-	// numbered if required
+	// Output a list of the items onto stdout, or the given stream,
+	// formatted nicely and numbered if required
 	template <typename T>
-	int print(bool label = false);
+	int print(bool label = false, std::ostream& out = std::cout);
 
 	// Remove all items from the inventory
 	void clear();
@@ -67,10 +90,26 @@ class Inventory
 
 	// Print the entire inventory; items, then weapons, then armor,
 	// but if the inventory is empty then output "Nothing"
-	int print(bool label = false);
+	int print(bool label = false, std::ostream& out = std::cout);
 
 	// Get a Json object representation of the inventory
 	JsonBox::Object getJson();
+
+	// Get a Json object representation of the difference between this
+	// inventory and the base inventory. Types with no differences are
+	// left out, so an unchanged inventory gives an empty object
+	JsonBox::Object getJsonDelta(Inventory& base);
+
+	// Apply a difference produced by getJsonDelta to the inventory
+	void loadDelta(JsonBox::Value& v, EntityManager* mgr);
+
+	// Number of items whose quantity differs from the base inventory
+	unsigned int deltaSize(Inventory& base);
+
+	// Write the same JSON as getJson and getJsonDelta straight out,
+	// without building the Json object first
+	void writeJson(JsonWriter& out);
+	void writeJsonDelta(JsonWriter& out, Inventory& base);
 };
 
 #endif /* INVENTORY_HPP */
@@ -0,0 +1,134 @@
+#include <vector>
+#include <deque>
+#include <memory>
+#include <functional>
+#include <thread>
+#include <mutex>
+#include <condition_variable>
+#include <atomic>
+
+#include "job_system.hpp"
+
+bool JobSystem::take(unsigned int self, std::function<void()>& job)
+{
+	unsigned int n = this->queues.size();
+	for(unsigned int i = 0; i < n; ++i)
+	{
+		Queue& queue = *this->queues[(self + i) % n];
+		std::lock_guard<std::mutex> lock(queue.mutex);
+		if(queue.jobs.empty()) continue;
+
+		// Our own jobs come off the back, stolen ones off the front
+		if(i == 0)
+		{
+			job = std::move(queue.jobs.back());
+			queue.jobs.pop_back();
+		}
+		else
+		{
+			job = std::move(queue.jobs.front());
+			queue.jobs.pop_front();
+		}
+		--this->queued;
+		return true;
+	}
+
+	return false;
+}
+
+void JobSystem::finish(std::function<void()>& job)
+{
+	job();
+
+	// The lock makes sure the caller of run is either waiting, and so gets
+	// woken, or hasn't checked pending yet and so will see it's zero
+	if(--this->pending == 0)
+	{
+		std::lock_guard<std::mutex> lock(this->mutex);
+		this->done.notify_all();
+	}
+
+	return;
+}
+
+void JobSystem::work(unsigned int self)
+{
+	std::function<void()> job;
+	while(true)
+	{
+		if(this->take(self, job))
+		{
+			this->finish(job);
+			continue;
+		}
+
+		// Nothing to do, so sleep until more jobs arrive
+		std::unique_lock<std::mutex> lock(this->mutex);
+		this->wake.wait(lock, [this]() { return this->stopping || this->queued > 0; });
+		if(this->stopping) return;
+	}
+}
+
+void JobSystem::run(std::vector<std::function<void()>>& jobs)
+{
+	if(jobs.empty()) return;
+
+	// Deal the jobs out between the queues. They're counted first, since
+	// a worker can take a job as soon as it's pushed, and taking one
+	// before it was counted would take the count below zero
+	this->pending += jobs.size();
+	{
+		std::lock_guard<std::mutex> lock(this->mutex);
+		this->queued += jobs.size();
+	}
+	for(unsigned int i = 0; i < jobs.size(); ++i)
+	{
+		Queue& queue = *this->queues[i % this->queues.size()];
+		std::lock_guard<std::mutex> lock(queue.mutex);
+		queue.jobs.push_back(jobs[i]);
+	}
+	this->wake.notify_all();
+
+	// Help out until there's nothing left to take, then wait for the jobs
+	// other threads are still running
+	std::function<void()> job;
+	while(this->take(0, job)) this->finish(job);
+
+	std::unique_lock<std::mutex> lock(this->mutex);
+	this->done.wait(lock, [this]() { return this->pending == 0; });
+
+	return;
+}
+
+unsigned int JobSystem::size()
+{
+	return this->threads.size();
+}
+
+JobSystem::JobSystem(unsigned int numThreads)
+{
+	if(numThreads == 0) numThreads = std::thread::hardware_concurrency();
+	if(numThreads == 0) numThreads = 1;
+
+	this->queued = 0;
+	this->pending = 0;
+	this->stopping = false;
+	for(unsigned int i = 0; i < numThreads; ++i)
+	{
+		this->queues.push_back(std::unique_ptr<Queue>(new Queue()));
+	}
+	for(unsigned int i = 0; i < numThreads; ++i)
+	{
+		this->threads.push_back(std::thread(&JobSystem::work, this, i));
+	}
+}
+
+JobSystem::~JobSystem()
+{
+	{
+		std::lock_guard<std::mutex> lock(this->mutex);
+		this->stopping = true;
+	}
+	this->wake.notify_all();
+	for(auto& thread : this->threads) thread.join();
+}
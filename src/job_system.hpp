@@ -0,0 +1,71 @@
+#ifndef JOB_SYSTEM_HPP
+#define JOB_SYSTEM_HPP
+
+#include <vector>
+#include <deque>
+#include <memory>
+#include <functional>
+#include <thread>
+#include <mutex>
+#include <condition_variable>
+#include <atomic>
+
+// Runs batches of jobs on a pool of worker threads. Each worker has its
+// own queue of jobs, and a worker that runs out of jobs steals them from
+// the other end of another worker's queue. Uneven jobs then get spread
+// across the workers without them all fighting over one shared queue
+class JobSystem
+{
+	private:
+
+	// A worker's queue. The worker takes jobs from the back, and other
+	// workers steal from the front
+	class Queue
+	{
+		public:
+
+		std::deque<std::function<void()>> jobs;
+		std::mutex mutex;
+	};
+
+	std::vector<std::unique_ptr<Queue>> queues;
+	std::vector<std::thread> threads;
+
+	// Number of jobs waiting in the queues, and the number that haven't
+	// finished yet
+	std::atomic<unsigned int> queued;
+	std::atomic<unsigned int> pending;
+
+	// Used to wake sleeping workers when jobs arrive, and the caller of
+	// run when they're done
+	std::mutex mutex;
+	std::condition_variable wake;
+	std::condition_variable done;
+	bool stopping;
+
+	// Take a job from the given queue, or steal one from another
+	bool take(unsigned int self, std::function<void()>& job);
+
+	// Run a job that was taken, noting when it's finished
+	void finish(std::function<void()>& job);
+
+	// Body of each worker thread
+	void work(unsigned int self);
+
+	public:
+
+	// Run every job, returning once they've all finished. The calling
+	// thread helps out rather than waiting idle
+	void run(std::vector<std::function<void()>>& jobs);
+
+	// Number of worker threads
+	unsigned int size();
+
+	// Start the given number of workers, or one per core if 0
+	JobSystem(unsigned int numThreads = 0);
+
+	// Stops the workers
+	~JobSystem();
+};
+
+#endif /* JOB_SYSTEM_HPP */
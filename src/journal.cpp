@@ -0,0 +1,265 @@
+#include <string>
+#include <iostream>
+#include <sstream>
+#include <fstream>
+#include <cstdio>
+#include <cstdint>
+#include <cerrno>
+#include <fcntl.h>
+#include <unistd.h>
+#include <JsonBox.h>
+
+#include "journal.hpp"
+#include "binary_io.hpp"
+#include "save_data.hpp"
+#include "save_writer.hpp"
+#include "player.hpp"
+#include "area.hpp"
+#include "door.hpp"
+#include "weapon.hpp"
+#include "armor.hpp"
+#include "entity_manager.hpp"
+#include "world_overlay.hpp"
+#include "trace.hpp"
+#include "alloc_stats.hpp"
+
+static bool fileExists(const std::string& filename)
+{
+	std::ifstream f(filename.c_str());
+	return f.good();
+}
+
+std::string Journal::segmentFile(const std::string& name, unsigned int segment)
+{
+	return name + ".journal." + std::to_string(segment);
+}
+
+void Journal::open(unsigned int segment)
+{
+	this->sync();
+	if(this->fd >= 0) close(this->fd);
+
+	this->segment = segment;
+	this->records = 0;
+	this->fd = ::open(segmentFile(this->name, segment).c_str(),
+		O_WRONLY | O_CREAT | O_TRUNC | O_APPEND, 0644);
+
+	return;
+}
+
+void Journal::record(JournalAction action, const std::string& id, int value)
+{
+	ALLOC_SCOPE(AllocTag::SAVE);
+
+	ByteWriter payload;
+	payload.putVarint(int(action));
+	payload.putString(id);
+	payload.putSigned(value);
+
+	// Each record is written as its length, the record itself, then a
+	// checksum of the record. If the game crashes whilst appending then
+	// the last record will be cut short or fail the checksum, and
+	// replaying stops there
+	ByteWriter frame;
+	frame.putString(payload.bytes);
+	frame.putFixed32(checksum(payload.bytes));
+
+	// Usually a single write, so the record reaches the file in one piece
+	// even if the game crashes straight afterwards. It's only in the
+	// operating system's cache until the journal is synced though, so it
+	// could still be lost if the machine itself goes down before then
+	if(this->fd < 0) return;
+	size_t written = 0;
+	while(written < frame.bytes.size())
+	{
+		ssize_t n = write(this->fd, frame.bytes.data() + written, frame.bytes.size() - written);
+		if(n < 0 && errno == EINTR) continue;
+		if(n <= 0) break;
+		written += n;
+	}
+	if(written < frame.bytes.size())
+	{
+		// Cut off whatever part of the record did get written, so that
+		// the records after it can still be replayed
+		off_t end = lseek(this->fd, 0, SEEK_END);
+		if(end >= 0 && written > 0) ftruncate(this->fd, end - written);
+		return;
+	}
+	++this->records;
+	this->unsynced = true;
+
+	return;
+}
+
+void Journal::sync()
+{
+	if(this->fd < 0 || !this->unsynced) return;
+	this->unsynced = false;
+
+	// The writer gets a descriptor of its own, so the journal can carry on
+	// with the segment, or close it, whilst the sync is waiting
+	int copy = this->writer != nullptr ? dup(this->fd) : -1;
+	if(copy >= 0)
+		this->writer->sync(copy);
+	else
+		fdatasync(this->fd);
+
+	return;
+}
+
+unsigned int Journal::size()
+{
+	return this->records;
+}
+
+void Journal::compact(Player& player, WorldOverlay& world, SaveWriter& writer, SaveFormat format)
+{
+	TRACE_SCOPE("Journal::compact");
+	ALLOC_SCOPE(AllocTag::SAVE);
+
+	// The save includes everything in the current segment, so new actions
+	// go into the next one. An empty segment can just be reused
+	if(this->records > 0) this->open(this->segment + 1);
+
+	writer.submit(player.snapshot(world, this->text, format, this->segment));
+
+	return;
+}
+
+unsigned int Journal::replay(Player& player, SaveData& data, WorldOverlay& world)
+{
+	TRACE_SCOPE("Journal::replay");
+
+	EntityManager* mgr = world.mgr;
+	unsigned int replayed = 0;
+
+	// A stream without a buffer, for what the replay would show
+	std::ostream quiet(nullptr);
+
+	for(unsigned int segment = savedSegment(data); ; ++segment)
+	{
+		std::ifstream f(segmentFile(data.name, segment).c_str(), std::ios::binary);
+		if(!f.good()) break;
+		std::stringstream ss;
+		ss << f.rdbuf();
+		std::string bytes = ss.str();
+
+		ByteReader in(bytes);
+		while(!in.atEnd())
+		{
+			std::string payload = in.getString();
+			uint32_t sum = in.getFixed32();
+			// Stop at a torn or corrupt record
+			if(!in.good || sum != checksum(payload)) break;
+
+			ByteReader record(payload);
+			JournalAction action = JournalAction(record.getVarint());
+			std::string id = record.getString();
+			int value = int(record.getSigned());
+			if(!record.good) break;
+
+			// The content may have changed since the record was written, so
+			// records referring to anything that's gone are skipped
+			switch(action)
+			{
+				case JournalAction::TRAVERSE:
+				{
+					Door* door = mgr->findEntity<Door>(id);
+					if(door == nullptr) continue;
+					player.traverse(door, world);
+					++player.moves;
+					player.visitedAreas.insert(player.currentArea);
+					break;
+				}
+				case JournalAction::SEARCH:
+				{
+					if(mgr->findEntity<Area>(id) == nullptr) continue;
+					Area* area = world.editArea(id);
+					player.inventory.merge(&(area->items));
+					area->items.clear();
+					break;
+				}
+				case JournalAction::EQUIP_WEAPON:
+				{
+					Weapon* weapon = mgr->findEntity<Weapon>(id);
+					if(weapon == nullptr && id != "nullptr") continue;
+					player.equipWeapon(weapon);
+					break;
+				}
+				case JournalAction::EQUIP_ARMOR:
+				{
+					Armor* armor = mgr->findEntity<Armor>(id);
+					if(armor == nullptr && id != "nullptr") continue;
+					player.equipArmor(armor);
+					break;
+				}
+				case JournalAction::BATTLE:
+					// Only won battles are recorded, so the creatures are gone
+					// until they respawn
+					if(mgr->findEntity<Area>(id) == nullptr) continue;
+					world.editArea(id)->clearCreatures(player.moves);
+					player.hp = value;
+					break;
+				case JournalAction::XP:
+				{
+					// Levels are grown straight after the experience is
+					// gained, so grow them again, without showing it. The
+					// battle was recorded with the health the player had
+					// after levelling up, so it isn't raised a second time
+					int hp = player.hp;
+					player.xp += value;
+					while(player.levelUp(quiet)) {}
+					player.hp = hp;
+					break;
+				}
+				case JournalAction::DROP:
+				{
+					// Creatures drop their loot where the battle was
+					Item* item = mgr->getItem(id);
+					if(item == nullptr || mgr->findEntity<Area>(player.currentArea) == nullptr) continue;
+					world.editArea(player.currentArea)->items.add(item, value);
+					break;
+				}
+				default:
+					break;
+			}
+			++replayed;
+		}
+	}
+
+	return replayed;
+}
+
+void Journal::removeSegmentsBefore(const std::string& name, unsigned int segment)
+{
+	// Segments are always numbered consecutively, so stop at the first
+	// one that has already gone
+	while(segment > 1 && std::remove(segmentFile(name, --segment).c_str()) == 0);
+
+	return;
+}
+
+unsigned int Journal::savedSegment(const SaveData& data)
+{
+	return data.journalSegment;
+}
+
+Journal::Journal(const std::string& name, SaveData& data, SaveWriter* writer)
+{
+	this->name = name;
+	this->fd = -1;
+	this->unsynced = false;
+	this->writer = writer;
+
+	// Carry on after the last segment on disk, so that nothing is
+	// overwritten before the next save has been taken
+	unsigned int last = savedSegment(data);
+	while(fileExists(segmentFile(name, last + 1))) ++last;
+	this->open(last + 1);
+}
+
+Journal::~Journal()
+{
+	this->sync();
+	if(this->fd >= 0) close(this->fd);
+}
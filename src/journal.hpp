@@ -0,0 +1,99 @@
+#ifndef JOURNAL_HPP
+#define JOURNAL_HPP
+
+#include <string>
+
+#include "save_data.hpp"
+#include "json_writer.hpp"
+
+class Player;
+class SaveWriter;
+class WorldOverlay;
+
+// Actions that change the game state and so need to be recorded
+enum class JournalAction { TRAVERSE = 1, SEARCH, EQUIP_WEAPON, EQUIP_ARMOR, BATTLE, XP, DROP };
+
+// Rather than rewriting the whole save after everything the player does,
+// each action is appended to a journal as a small record. Every so often
+// the journal is compacted by taking a full save, and when the game is
+// loaded any actions recorded after the save are replayed on top of it.
+// The journal is split into numbered segment files <name>.journal.<n>;
+// compacting starts a new segment, and the old segments are deleted once
+// the save containing them has been written
+class Journal
+{
+	private:
+
+	// Name of the player the journal belongs to
+	std::string name;
+
+	// Number of the segment being appended to
+	unsigned int segment;
+
+	// Number of records in the current segment
+	unsigned int records;
+
+	// File descriptor of the current segment
+	int fd;
+
+	// True if records have been written since the segment was last synced
+	bool unsynced;
+
+	// Writer the syncs are handed to, or nullptr to sync straight away
+	SaveWriter* writer;
+
+	// Writes the text of JSON saves, kept so that compacting doesn't have
+	// to grow a new buffer each time
+	JsonWriter text;
+
+	// Name of the file holding the given segment
+	static std::string segmentFile(const std::string& name, unsigned int segment);
+
+	// Close the current segment and start appending to a new one
+	void open(unsigned int segment);
+
+	public:
+
+	// Number of records after which the journal should be compacted
+	static const unsigned int compactionInterval = 64;
+
+	// Append an action to the journal. The id is of the door, area or
+	// item the action involved and value holds any number that goes
+	// with it, such as the experience gained
+	void record(JournalAction action, const std::string& id, int value = 0);
+
+	// Make sure every record written so far reaches the disk, so that it
+	// survives the machine crashing or losing power, not just the game
+	// crashing. Syncing after every record would make each action wait
+	// for the disk, so it's done once a turn instead. If the journal has
+	// a writer the sync is done on the writer's thread, together with any
+	// other journals', so the game doesn't wait for the disk at all
+	void sync();
+
+	// Number of actions recorded since the last compaction
+	unsigned int size();
+
+	// Save the player in the background and start a new segment. The old
+	// segments are removed by the writer once the save is on disk
+	void compact(Player& player, WorldOverlay& world, SaveWriter& writer, SaveFormat format);
+
+	// Apply every action recorded since the save was taken to the player
+	// and their view of the world. Returns the number of actions replayed
+	static unsigned int replay(Player& player, SaveData& data, WorldOverlay& world);
+
+	// Delete all of the player's segments numbered below segment
+	static void removeSegmentsBefore(const std::string& name, unsigned int segment);
+
+	// Segment number recorded in the save, or 0 if it didn't use a journal
+	static unsigned int savedSegment(const SaveData& data);
+
+	// Open the journal for the player, appending after any segments that
+	// already exist. data is the player's save, if they have one. Syncs
+	// are handed to the writer if one is given
+	Journal(const std::string& name, SaveData& data, SaveWriter* writer = nullptr);
+
+	// Destructor
+	~Journal();
+};
+
+#endif /* JOURNAL_HPP */
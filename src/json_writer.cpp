@@ -0,0 +1,155 @@
+#include <string>
+#include <vector>
+#include <cstdio>
+#include <cstring>
+
+#include "json_writer.hpp"
+
+void JsonWriter::separate()
+{
+	if(this->afterKey)
+	{
+		this->afterKey = false;
+		return;
+	}
+	if(this->first.empty()) return;
+
+	if(!this->first.back()) this->buffer += ',';
+	this->first.back() = false;
+	this->indent();
+}
+
+void JsonWriter::indent()
+{
+	this->buffer += '\n';
+	this->buffer.append(this->first.size(), '\t');
+}
+
+void JsonWriter::writeString(const char* s, size_t size)
+{
+	this->buffer += '"';
+	for(size_t i = 0; i < size; ++i)
+	{
+		char c = s[i];
+		switch(c)
+		{
+			case '"': this->buffer += "\\\""; break;
+			case '\\': this->buffer += "\\\\"; break;
+			case '\n': this->buffer += "\\n"; break;
+			case '\t': this->buffer += "\\t"; break;
+			case '\r': this->buffer += "\\r"; break;
+			default:
+				if((unsigned char)c < 0x20)
+				{
+					char escaped[8];
+					std::snprintf(escaped, sizeof(escaped), "\\u%04x", c);
+					this->buffer += escaped;
+				}
+				else
+				{
+					this->buffer += c;
+				}
+				break;
+		}
+	}
+	this->buffer += '"';
+}
+
+void JsonWriter::beginObject()
+{
+	this->separate();
+	this->buffer += '{';
+	this->first.push_back(true);
+}
+
+void JsonWriter::endObject()
+{
+	bool empty = this->first.back();
+	this->first.pop_back();
+	if(!empty) this->indent();
+	this->buffer += '}';
+}
+
+void JsonWriter::beginArray()
+{
+	this->separate();
+	this->buffer += '[';
+	this->first.push_back(true);
+}
+
+void JsonWriter::endArray()
+{
+	bool empty = this->first.back();
+	this->first.pop_back();
+	if(!empty) this->indent();
+	this->buffer += ']';
+}
+
+void JsonWriter::key(const std::string& k)
+{
+	this->separate();
+	this->writeString(k.data(), k.size());
+	this->buffer += " : ";
+	this->afterKey = true;
+}
+
+void JsonWriter::key(const char* k)
+{
+	this->separate();
+	this->writeString(k, std::strlen(k));
+	this->buffer += " : ";
+	this->afterKey = true;
+}
+
+void JsonWriter::value(const std::string& v)
+{
+	this->separate();
+	this->writeString(v.data(), v.size());
+}
+
+void JsonWriter::value(const char* v)
+{
+	this->separate();
+	this->writeString(v, std::strlen(v));
+}
+
+void JsonWriter::value(int v)
+{
+	this->separate();
+	char s[16];
+	int n = std::snprintf(s, sizeof(s), "%d", v);
+	this->buffer.append(s, n);
+}
+
+void JsonWriter::value(unsigned int v)
+{
+	this->value(int(v));
+}
+
+void JsonWriter::value(double v)
+{
+	this->separate();
+	char s[32];
+	int n = std::snprintf(s, sizeof(s), "%.17g", v);
+	this->buffer.append(s, n);
+	// Make sure it reads back as a double rather than an integer
+	if(std::strpbrk(s, ".eEni") == nullptr) this->buffer += ".0";
+}
+
+void JsonWriter::value(bool v)
+{
+	this->separate();
+	this->buffer += v ? "true" : "false";
+}
+
+void JsonWriter::clear()
+{
+	this->buffer.clear();
+	this->first.clear();
+	this->afterKey = false;
+}
+
+JsonWriter::JsonWriter()
+{
+	this->afterKey = false;
+}
@@ -0,0 +1,59 @@
+#ifndef JSON_WRITER_HPP
+#define JSON_WRITER_HPP
+
+#include <string>
+#include <vector>
+
+// Writes JSON text straight into a buffer, without building a tree of
+// JsonBox values first. Output is laid out the same way as JsonBox's,
+// with one member per line and tabs for indentation. The buffer keeps
+// its memory when cleared, so a writer that is reused doesn't need to
+// allocate once it has grown large enough
+class JsonWriter
+{
+	private:
+
+	// One entry per open object or array, true until the first member
+	// or element has been written
+	std::vector<bool> first;
+
+	// True if a key has just been written, so the next value follows
+	// it on the same line
+	bool afterKey;
+
+	// Write a comma and new line if needed before the next member or element
+	void separate();
+
+	void indent();
+
+	// Write a string with quotes and escapes
+	void writeString(const char* s, size_t size);
+
+	public:
+
+	// The JSON written so far
+	std::string buffer;
+
+	void beginObject();
+	void endObject();
+	void beginArray();
+	void endArray();
+
+	// Write the key of the next member of an object
+	void key(const std::string& k);
+	void key(const char* k);
+
+	void value(const std::string& v);
+	void value(const char* v);
+	void value(int v);
+	void value(unsigned int v);
+	void value(double v);
+	void value(bool v);
+
+	// Empty the buffer, ready to write something new
+	void clear();
+
+	JsonWriter();
+};
+
+#endif /* JSON_WRITER_HPP */
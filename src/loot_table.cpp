@@ -0,0 +1,268 @@
+#include <string>
+#include <vector>
+#include <random>
+#include <unordered_map>
+#include <algorithm>
+#include <cmath>
+#include <JsonBox.h>
+
+#include "loot_table.hpp"
+#include "item.hpp"
+#include "inventory.hpp"
+#include "entity_manager.hpp"
+
+// Tables nested deeper than this are ignored, in case they refer to
+// each other in a loop
+static const unsigned int maxDepth = 16;
+
+// Read a drop of the type {"id": id, "weight": w, "min": m, "max": n}.
+// Everything but the id is optional
+static LootTable::Drop loadDrop(JsonBox::Value& v)
+{
+	JsonBox::Object o = v.getObject();
+
+	LootTable::Drop drop;
+	drop.id = o.find("id") != o.end() ? o["id"].getString() : "nullptr";
+	drop.item = nullptr;
+	drop.table = nullptr;
+	drop.min = o.find("min") != o.end() ? o["min"].getInteger() : 1;
+	drop.max = o.find("max") != o.end() ? o["max"].getInteger() : drop.min;
+	if(drop.max < drop.min) drop.max = drop.min;
+	drop.weight = 1.0;
+	if(o.find("weight") != o.end())
+	{
+		JsonBox::Value& w = o["weight"];
+		drop.weight = w.isInteger() ? w.getInteger() : w.getDouble();
+	}
+
+	return drop;
+}
+
+LootTable::LootTable(std::string id, JsonBox::Value& v, EntityManager* mgr) : Entity(id)
+{
+	this->load(v, mgr);
+}
+
+void LootTable::load(JsonBox::Value& v, EntityManager*)
+{
+	JsonBox::Object o = v.getObject();
+
+	this->rolls = o.find("rolls") != o.end() ? o["rolls"].getInteger() : 1;
+
+	this->guaranteed.clear();
+	for(auto drop : o["guaranteed"].getArray())
+	{
+		this->guaranteed.push_back(loadDrop(drop));
+	}
+	this->drops.clear();
+	for(auto drop : o["drops"].getArray())
+	{
+		this->drops.push_back(loadDrop(drop));
+	}
+
+	this->buildAliasTable();
+
+	return;
+}
+
+void LootTable::buildAliasTable()
+{
+	unsigned int n = this->drops.size();
+	this->probability.assign(n, 1.0);
+	this->alias.assign(n, 0);
+	this->chance.assign(n, n > 0 ? 1.0 / n : 0.0);
+
+	double total = 0.0;
+	for(auto& drop : this->drops) total += drop.weight;
+	if(n == 0 || total <= 0.0) return;
+
+	// Scale the weights so that a column's fair share is 1, then split the
+	// drops into those with less than their share and those with more
+	std::vector<double> scaled(n);
+	std::vector<unsigned int> small, large;
+	for(unsigned int i = 0; i < n; ++i)
+	{
+		scaled[i] = this->drops[i].weight * n / total;
+		if(scaled[i] < 1.0)
+			small.push_back(i);
+		else
+			large.push_back(i);
+	}
+
+	// Fill up each small column with part of a large one. The large one
+	// then has less left over, and may become small itself
+	while(!small.empty() && !large.empty())
+	{
+		unsigned int s = small.back();
+		unsigned int l = large.back();
+		small.pop_back();
+		large.pop_back();
+
+		this->probability[s] = scaled[s];
+		this->alias[s] = l;
+		scaled[l] -= 1.0 - scaled[s];
+		if(scaled[l] < 1.0)
+			small.push_back(l);
+		else
+			large.push_back(l);
+	}
+
+	// Whatever is left over is a full column, give or take rounding errors
+	for(auto i : small) this->probability[i] = 1.0;
+	for(auto i : large) this->probability[i] = 1.0;
+
+	// A drop is picked from its own column, and from every column it's
+	// the alias of
+	for(unsigned int i = 0; i < n; ++i)
+	{
+		this->chance[i] = this->probability[i] / n;
+	}
+	for(unsigned int i = 0; i < n; ++i)
+	{
+		this->chance[this->alias[i]] += (1.0 - this->probability[i]) / n;
+	}
+
+	return;
+}
+
+void LootTable::link(EntityManager* mgr)
+{
+	for(auto list : { &this->guaranteed, &this->drops })
+	{
+		for(auto& drop : *list)
+		{
+			if(drop.id == "nullptr") continue;
+			if(drop.id.compare(0, entityToString<LootTable>().size(), entityToString<LootTable>()) == 0)
+				drop.table = mgr->getEntity<LootTable>(drop.id);
+			else
+				drop.item = mgr->getItem(drop.id);
+		}
+	}
+
+	return;
+}
+
+unsigned int LootTable::pick(std::mt19937& gen)
+{
+	unsigned int column = std::uniform_int_distribution<unsigned int>(0, this->drops.size() - 1)(gen);
+	if(std::uniform_real_distribution<double>(0.0, 1.0)(gen) < this->probability[column])
+		return column;
+	else
+		return this->alias[column];
+}
+
+// Total quantity given by a drop picked the given number of times. Each
+// pick gives between min and max, or nothing if that's not positive. A
+// few picks are drawn one at a time, but the sum of many is close enough
+// to normal that it's drawn from a normal distribution with the same mean
+// and variance instead
+static unsigned long long quantity(LootTable::Drop& drop, unsigned long long picks, std::mt19937& gen)
+{
+	if(drop.max <= 0) return 0;
+
+	static const unsigned long long maxExact = 16;
+	if(drop.min == drop.max || picks <= maxExact)
+	{
+		unsigned long long total = 0;
+		std::uniform_int_distribution<int> dist(drop.min, drop.max);
+		for(unsigned long long i = 0; i < picks; ++i)
+		{
+			int count = drop.min == drop.max ? drop.min : dist(gen);
+			if(count > 0) total += count;
+		}
+		return total;
+	}
+
+	double values = drop.max - drop.min + 1;
+	double mean = 0.0;
+	double square = 0.0;
+	for(int count = std::max(drop.min, 1); count <= drop.max; ++count)
+	{
+		mean += count / values;
+		square += double(count) * count / values;
+	}
+	double sum = std::normal_distribution<double>(picks * mean,
+		std::sqrt(picks * (square - mean * mean)))(gen);
+	sum = std::max(0.0, std::min(std::round(sum), double(picks) * drop.max));
+
+	return (unsigned long long)sum;
+}
+
+void LootTable::give(Drop& drop, unsigned long long picks, std::mt19937& gen,
+	std::unordered_map<Item*, unsigned long long>& totals, unsigned int depth)
+{
+	if(picks == 0) return;
+	unsigned long long count = quantity(drop, picks, gen);
+	if(count == 0) return;
+
+	if(drop.item != nullptr)
+	{
+		totals[drop.item] += count;
+	}
+	else if(drop.table != nullptr && depth < maxDepth)
+	{
+		drop.table->rollMany(count, gen, totals, depth + 1);
+	}
+
+	return;
+}
+
+void LootTable::rollMany(unsigned long long times, std::mt19937& gen,
+	std::unordered_map<Item*, unsigned long long>& totals, unsigned int depth)
+{
+	if(times == 0) return;
+	for(auto& drop : this->guaranteed)
+	{
+		this->give(drop, times, gen, totals, depth);
+	}
+	if(this->drops.empty()) return;
+
+	// Fewer picks than drops are quicker to make one at a time. Otherwise
+	// the picks are shared out between the drops, each drop taking its
+	// share of whatever the drops before it left
+	unsigned long long picks = times * this->rolls;
+	if(picks < this->drops.size())
+	{
+		for(unsigned long long i = 0; i < picks; ++i)
+		{
+			this->give(this->drops[this->pick(gen)], 1, gen, totals, depth);
+		}
+		return;
+	}
+	double left = 1.0;
+	for(unsigned int i = 0; i < this->drops.size() && picks > 0; ++i)
+	{
+		unsigned long long n = picks;
+		if(i + 1 < this->drops.size() && this->chance[i] < left)
+		{
+			double p = std::max(0.0, this->chance[i] / left);
+			n = std::binomial_distribution<unsigned long long>(picks, p)(gen);
+		}
+		left -= this->chance[i];
+		picks -= n;
+		this->give(this->drops[i], n, gen, totals, depth);
+	}
+
+	return;
+}
+
+void LootTable::rollMany(unsigned long long times, std::mt19937& gen,
+	std::unordered_map<Item*, unsigned long long>& totals)
+{
+	this->rollMany(times, gen, totals, 0);
+
+	return;
+}
+
+void LootTable::roll(Inventory& inventory, std::mt19937& gen, unsigned int times)
+{
+	// Add up the drops first, so each item is only added once
+	std::unordered_map<Item*, unsigned long long> totals;
+	this->rollMany(times, gen, totals);
+	for(auto& total : totals)
+	{
+		inventory.add(total.first, int(total.second));
+	}
+
+	return;
+}
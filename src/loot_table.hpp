@@ -0,0 +1,115 @@
+#ifndef LOOT_TABLE_HPP
+#define LOOT_TABLE_HPP
+
+#include <string>
+#include <vector>
+#include <random>
+#include <unordered_map>
+#include <JsonBox.h>
+
+#include "entity.hpp"
+
+class Item;
+class Inventory;
+class EntityManager;
+
+// Decides what a creature drops when it's killed. A table has a list of
+// drops which are always given, and a list of weighted drops of which
+// some number are picked at random. A drop is either an item, weapon or
+// armor, another loot table to roll on, or nothing at all.
+//
+// The weights are turned into an alias table when the table is loaded.
+// Every drop gets a column, and any column with less than its fair share
+// of the total weight is topped up with another drop, its alias. Picking
+// a drop then only takes a random column and a random choice between the
+// column's drop and its alias, however many drops there are.
+//
+// Rolling many times at once, such as for a horde, doesn't roll each time
+// separately. The picks are shared out between the drops in one go, and
+// the quantity of each drop is drawn once for all the times it was picked,
+// so it takes as long to roll for a thousand creatures as for ten
+class LootTable : public Entity
+{
+	public:
+
+	class Drop
+	{
+		public:
+
+		// Id of the item or loot table, or "nullptr" for nothing
+		std::string id;
+
+		// What the id refers to. At most one of these is set
+		Item* item;
+		LootTable* table;
+
+		// Quantity is chosen uniformly between these
+		int min;
+		int max;
+
+		// Weight compared to the other drops in the table
+		double weight;
+	};
+
+	// Drops that are always given
+	std::vector<Drop> guaranteed;
+
+	// Drops picked at random
+	std::vector<Drop> drops;
+
+	// Alias table for the random drops. Column i gives drop i with the
+	// given probability, and drop alias[i] otherwise
+	std::vector<double> probability;
+	std::vector<unsigned int> alias;
+
+	// Chance of each random drop being picked by the alias table, used to
+	// share out many picks at once
+	std::vector<double> chance;
+
+	// Number of random drops picked each time the table is rolled
+	unsigned int rolls;
+
+	private:
+
+	// Build the alias table from the weights of the random drops
+	void buildAliasTable();
+
+	// Pick one of the random drops
+	unsigned int pick(std::mt19937& gen);
+
+	// Give the drop as many times as it was picked, rolling on it if it's
+	// a table. depth stops tables that refer to each other from rolling
+	// forever
+	void give(Drop& drop, unsigned long long picks, std::mt19937& gen,
+		std::unordered_map<Item*, unsigned long long>& totals, unsigned int depth);
+
+	// Roll on the table the given number of times
+	void rollMany(unsigned long long times, std::mt19937& gen,
+		std::unordered_map<Item*, unsigned long long>& totals, unsigned int depth);
+
+	public:
+
+	// Constructor
+	LootTable(std::string id, JsonBox::Value& v, EntityManager* mgr);
+
+	// Load the loot table from the Json value. The manager isn't needed,
+	// since the drops are only looked up once every table is loaded, by
+	// link, but every entity is loaded the same way
+	void load(JsonBox::Value& v, EntityManager*);
+
+	// Look up the items and tables the drops refer to. Called once every
+	// table has been loaded, so that tables can refer to each other in
+	// any order
+	void link(EntityManager* mgr);
+
+	// Roll on the table the given number of times, adding everything
+	// dropped to the inventory
+	void roll(Inventory& inventory, std::mt19937& gen, unsigned int times = 1);
+
+	// Roll on the table the given number of times, adding the quantity of
+	// each item dropped to totals. Used to simulate large numbers of drops
+	void rollMany(unsigned long long times, std::mt19937& gen,
+		std::unordered_map<Item*, unsigned long long>& totals);
+};
+
+#endif /* LOOT_TABLE_HPP */
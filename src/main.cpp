@@ -1,307 +1,204 @@
-#include <algorithm>
+#include <memory>
 #include <iostream>
 #include <fstream>
-#include <utility>
 #include <cstdlib>
 #include <string>
-#include <vector>
 #include <ctime>
-#include <list>
-#include <map>
+#include <algorithm>
+#include <thread>
+#include <unistd.h>
 #include <JsonBox.h>
 
 #include "item.hpp"
 #include "weapon.hpp"
 #include "armor.hpp"
-#include "inventory.hpp"
 #include "creature.hpp"
-#include "player.hpp"
-#include "dialogue.hpp"
 #include "area.hpp"
 #include "door.hpp"
-#include "battle.hpp"
 #include "entity_manager.hpp"
-
-// New character menu
-Player startGame();
-
-// Character information menu, displays the items the player has, their
-// current stats etc.
-void dialogueMenu(Player& player);
+#include "save_data.hpp"
+#include "save_writer.hpp"
+#include "save_store.hpp"
+#include "world_graph.hpp"
+#include "loot_table.hpp"
+#include "world_sim.hpp"
+#include "session.hpp"
+#include "server.hpp"
+#include "event_bus.hpp"
+#include "batch.hpp"
+#include "soak.hpp"
+#include "renderer.hpp"
+#include "trace.hpp"
+#include "alloc_stats.hpp"
 
 // Keeps track of items, weapons, creatures etc.
 EntityManager entityManager;
 
-int main()
+int main(int argc, char* argv[])
 {
+#ifdef RPG_TRACE
+	// Before any threads are started, so that only the tracer's own
+	// thread waits for the signal asking for the trace
+	Trace::start("trace.json");
+#endif
+
+	// Saves are written as JSON unless asked for the binary format. They
+	// can also be kept in a single store shared by every player, instead
+	// of each player having their own files. Given an address to serve
+	// on, players connect over sockets instead of playing on the terminal.
+	// Given a log file, everything that happens in the game is written to
+	// it. Given a script, the input is read from it rather than typed.
+	// Asked to soak, bots play the game by themselves for that many seconds
+	SaveFormat saveFormat = SaveFormat::JSON;
+	std::unique_ptr<SaveStore> saveStore;
+	std::string serveAddress;
+	unsigned int numWorkers = 0;
+	unsigned int maxPlayers = 4096;
+	std::string eventLogName;
+	std::string scriptName;
+	unsigned int scriptRuns = 1;
+	bool quiet = false;
+	double soakSeconds = 0;
+	unsigned int numBots = 0;
+	unsigned int botTurns = 500;
+	double reportInterval = 10;
+	for(int i = 1; i < argc; ++i)
+	{
+		std::string arg = argv[i];
+		if(arg == "--binary-saves") saveFormat = SaveFormat::BINARY;
+		if(arg == "--save-store") saveStore.reset(new SaveStore("saves.db"));
+		if(arg == "--serve" && i+1 < argc) serveAddress = argv[++i];
+		if(arg == "--workers" && i+1 < argc) numWorkers = std::atoi(argv[++i]);
+		if(arg == "--max-players" && i+1 < argc) maxPlayers = std::atoi(argv[++i]);
+		if(arg == "--event-log" && i+1 < argc) eventLogName = argv[++i];
+		if(arg == "--script" && i+1 < argc) scriptName = argv[++i];
+		if(arg == "--runs" && i+1 < argc) scriptRuns = std::atoi(argv[++i]);
+		if(arg == "--quiet") quiet = true;
+		if(arg == "--soak" && i+1 < argc) soakSeconds = std::atof(argv[++i]);
+		if(arg == "--bots" && i+1 < argc) numBots = std::atoi(argv[++i]);
+		if(arg == "--bot-turns" && i+1 < argc) botTurns = std::atoi(argv[++i]);
+		if(arg == "--report-every" && i+1 < argc) reportInterval = std::atof(argv[++i]);
+	}
+	// The store holds saves in the binary format, so snapshots might as
+	// well be taken that way. A store that can't be used would lose every
+	// save made, so the game isn't played at all
+	if(saveStore && !saveStore->good())
+	{
+		std::cerr << saveStore->getError() << std::endl;
+		return 1;
+	}
+	if(saveStore) saveFormat = SaveFormat::BINARY;
+
 	// Load the entities
 	entityManager.loadJson<Item>("items.json");
 	entityManager.loadJson<Weapon>("weapons.json");
 	entityManager.loadJson<Armor>("armor.json");
+	entityManager.loadJson<LootTable>("loot.json");
+	for(auto table : entityManager.getEntities<LootTable>())
+	{
+		table->link(&entityManager);
+	}
 	entityManager.loadJson<Creature>("creatures.json");
 	entityManager.loadJson<Door>("doors.json");
 	entityManager.loadJson<Area>("areas.json");
 
+#ifdef RPG_ALLOC_STATS
+	entityManager.memoryReport(std::cerr);
+#endif
+
+	// Work out how the areas are connected, so routes between them can
+	// be found quickly
+	WorldGraph worldGraph;
+	worldGraph.build(&entityManager);
+
 	// Seed the random number generator with the system time, so the
 	// random numbers produced by rand() will be different each time
 	std::srand(std::time(nullptr));
 
-	Player player = startGame();
+	// Saves are written in the background so the game doesn't have to
+	// wait for them. Any outstanding saves are written when the writer
+	// is destroyed at the end of main
+	SaveWriter saveWriter(saveStore.get());
 
-	// Set the current area to be the first area in the atlas,
-	// placing the player there upon game start
-	player.currentArea = "area_01";
+	SessionContext context(&entityManager, &worldGraph, &saveWriter, saveStore.get(), saveFormat);
 
-	// Play the game until a function breaks the loop and closes it
-	while(1)
+	// The log is written on the event bus's own thread, so the game never
+	// waits for the disk. Declared after the log so the bus is stopped,
+	// and has written everything, before the log is closed
+	std::ofstream eventLog;
+	EventBus eventBus;
+	if(eventLogName != "")
 	{
-		// Mark the current player as visited
-		player.visitedAreas.insert(player.currentArea);
-
-		// Pointer to to the current area for convenience
-		Area* areaPtr = player.getAreaPtr(&entityManager);
-
-		// Autosave the game
-		player.save(&entityManager);
-
-		// If the area has any creatures in it, start a battle with them
-		if(areaPtr->creatures.size() > 0)
+		eventLog.open(eventLogName, std::ios::app);
+		eventBus.subscribe([&eventLog](const GameEvent& event)
 		{
-			// Create a vector of pointers to the creatures in the area
-			std::vector<Creature*> combatants;
-			std::cout << "You are attacked by ";
-			for(int i = 0; i < areaPtr->creatures.size(); ++i)
-			{
-				Creature* c = &(areaPtr->creatures[i]);
-				combatants.push_back(c);
-				std::cout << c->name << (i == areaPtr->creatures.size()-1 ? "!\n" : ", ");
-			}
-			// Add the player to the combatant vector
-			combatants.push_back(&player);
-			// Run the battle
-			Battle battle(combatants);
-			battle.run();
-
-			// If the player is still alive, grant them some experience, assuming
-			// that every creature was killed
-			if(player.hp > 0)
-			{
-				// Or use std::accumulate, but that requires an additional header
-				unsigned int xp = 0;
-				for(auto creature : areaPtr->creatures) xp += creature.xp;
-				std::cout << "You gained " << xp << " experience!\n";
-				player.xp += xp;
-				// Remove the creatures from the area
-				areaPtr->creatures.clear();
-				// Restart the loop to force a save, then the game will carry on
-				// as usual
-				continue;
-			}
-			// Otherwise player is dead, so end the program
-			else
-			{
-				std::cout << "\t----YOU DIED----\n    Game Over\n";
-				return 0;
-			}
-		}
-
-		// Add the search and movement options to the dialogue
-		Dialogue roomOptions = areaPtr->dialogue;
-		for(auto door : areaPtr->doors)
-		{
-			roomOptions.addChoice("Go through the " + door->description);
-		}
-		roomOptions.addChoice("Search");
-
-		// Activate the current area's dialogue
-		int result = roomOptions.activate();
+			eventLog << event.str() << '\n';
+		});
+		eventBus.start();
+		context.events = &eventBus;
+	}
 
-		if(result == 0)
-		{
-			dialogueMenu(player);
-		}
-		else if(result <= areaPtr->dialogue.size())
+	if(serveAddress != "")
+	{
+		// Every session shares the content loaded above. The world sim
+		// is left out, since it only moves creatures around one player
+		Server server(&context, numWorkers, maxPlayers);
+		if(!server.listen(serveAddress))
 		{
-			// Add more events here
+			std::cerr << "Couldn't listen on " << serveAddress << std::endl;
+			return 1;
 		}
-		else if(result < roomOptions.size())
-		{
-			Door* door = areaPtr->doors.at(result-areaPtr->dialogue.size()-1);
-			int flag = player.traverse(door);
+		std::cout << "Serving on " << serveAddress << std::endl;
+		server.run();
 
-			switch(flag)
-			{
-				default:
-				case 0:
-					std::cout << "The " << door->description << " is locked." << std::endl;
-					break;
-				case 1:
-					std::cout << "You unlock the " << door->description << " and go through it." << std::endl;
-					break;
-				case 2:
-					std::cout << "You go through the " << door->description << "." << std::endl;
-					break;
-			}
-		}
-		else
-		{
-			std::cout << "You find:" << std::endl;
-			areaPtr->items.print();
-			player.inventory.merge(&(areaPtr->items));
-			areaPtr->items.clear();
-		}
+		return 0;
 	}
 
-	return 0;
-}
-
-// Create a new character or load an existing one
-Player startGame()
-{
-	// Ask for a name and class
-	// Name does not use a dialogue since dialogues only request options,
-	// not string input. Could be generalised into its own TextInput
-	// class, but not really necessary
-	std::cout << "What's your name?" << std::endl;
-	std::string name;
-	std::cin >> name;
-
-	// Check for existence then open using JsonBox if it exists
-	std::ifstream f((name + ".json").c_str());
-	if(f.good())
+	// Let the bots play, one per core unless told otherwise. Like the
+	// server, there are many sessions, so the world sim is left out
+	if(soakSeconds > 0)
 	{
-		f.close();
-		// Load the player
-		JsonBox::Value saveData;
-		JsonBox::Value areaData;
-		saveData.loadFromFile(name + ".json");
-		areaData.loadFromFile(name + "_areas.json");
-		Player player = Player(saveData, areaData, &entityManager);
+		if(numBots == 0) numBots = std::max(1u, std::thread::hardware_concurrency());
+		Soak soak(&context, botTurns);
+		soak.run(numBots, soakSeconds, reportInterval, std::cerr);
 
-		// Return the player
-		return player;
+		return 0;
 	}
-	else
-	{
-		f.close();
-		int result = Dialogue(
-			"Choose your class",
-			{"Fighter", "Rogue"}).activate();
-
-		switch(result)
-		{
-			// Fighter class favours strength
-			case 1:
-				return Player(name, 15, 5, 4, 1.0/64.0, 0, 1, "Fighter");
 
-			// Rogue class favours agility
-			case 2:
-				return Player(name, 15, 4, 5, 1.0/64.0, 0, 1, "Rogue");
+	// Creatures that move by themselves are moved around the player's
+	// world in parallel once per turn
+	WorldSim worldSim(&worldGraph);
+	context.sim = &worldSim;
+	context.single = true;
 
-			// Default case that should never happen, but it's good to be safe
-			default:
-				return Player(name, 15, 4, 4, 1.0/64.0, 0, 1, "Adventurer");
-		}
-	}
-}
-
-void dialogueMenu(Player& player)
-{
-	// Output the menu
-	int result = Dialogue(
-		"Menu\n====",
-		{"Items", "Equipment", "Character"}).activate();
-
-	switch(result)
+	// Play through the script instead, showing the game unless asked to
+	// be quiet, then say how quickly it went
+	if(scriptName != "")
 	{
-		// Print the items that the player owns
-		case 1:
-			std::cout << "Items\n=====\n";
-			player.inventory.print();
-			std::cout << "----------------\n";
-			break;
-		// Print the equipment that the player is wearing (if they are
-		// wearing anything) and then ask if they want to equip a weapon
-		// or some armor
-		case 2:
+		Batch batch;
+		if(!batch.load(scriptName))
 		{
-			std::cout << "Equipment\n=========\n";
-			std::cout << "Armor: "
-				<< (player.equippedArmor != nullptr ?
-					player.equippedArmor->name : "Nothing")
-				<< std::endl;
-			std::cout << "Weapon: "
-				<< (player.equippedWeapon != nullptr ?
-					player.equippedWeapon->name : "Nothing")
-				<< std::endl;
-
-			int result2 = Dialogue(
-				"",
-				{"Equip Armor", "Equip Weapon", "Close"}).activate();
-
-			// Equipping armor
-			if(result2 == 1)
-			{
-				int userInput = 0;
-
-				// Cannot equip armor if they do not have any
-				// Print a list of the armor and retrieve the amount
-				// of armor in one go
-				int numItems = player.inventory.print<Armor>(true);
-				if(numItems == 0) break;
-
-				while(!userInput)
-				{
-					// Choose a piece of armor to equip
-					std::cout << "Equip which item?" << std::endl;
-					std::cin >> userInput;
-					// Equipment is numbered but is stored in a list,
-					// so the number must be converted into a list element
-					if(userInput >= 1 && userInput <= numItems)
-					{
-						player.equipArmor(player.inventory.get<Armor>(userInput-1));
-					}
-				}
-			}
-			// Equip a weapon, using the same algorithms as for armor
-			else if(result2 == 2)
-			{
-				int userInput = 0;
-				int numItems = player.inventory.print<Weapon>(true);
-
-				if(numItems == 0) break;
-
-				while(!userInput)
-				{
-					std::cout << "Equip which item?" << std::endl;
-					std::cin >> userInput;
-					if(userInput >= 1 && userInput <= numItems)
-					{
-						player.equipWeapon(player.inventory.get<Weapon>(userInput-1));
-					}
-				}
-			}
-			std::cout << "----------------\n";
-			break;
+			std::cerr << "Couldn't read " << scriptName << std::endl;
+			return 1;
 		}
-		// Output the character information, including name, class (if
-		// they have one), stats, level, and experience
-		case 3:
-			std::cout << "Character\n=========\n";
-			std::cout << player.name;
-			if(player.className != "") std::cout << " the " << player.className;
-			std::cout << std::endl;
+		Renderer screen(quiet ? -1 : STDOUT_FILENO);
+		batch.play(&context, scriptRuns, screen);
+		batch.report(std::cerr);
+
+		return 0;
+	}
 
-			std::cout << "Health:   " << player.hp << " / " << player.maxHp << std::endl;
-			std::cout << "Strength: " << player.strength << std::endl;
-			std::cout << "Agility:  " << player.agility << std::endl;
-			std::cout << "Level:    " << player.level << " (" << player.xp;
-			std::cout <<  " / " << player.xpToLevel(player.level+1) << ")" << std::endl;
-			std::cout << "----------------\n";
-			break;
-		default:
-			break;
+	// Play on the terminal, feeding the session each line typed and
+	// showing everything it has to say in one go
+	Renderer screen(STDOUT_FILENO);
+	Session session(&context, screen.out);
+	screen.present();
+	std::string line;
+	while(!session.over() && std::getline(std::cin, line))
+	{
+		session.feed(line);
+		screen.present();
 	}
 
-	return;
+	return 0;
 }
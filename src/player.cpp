@@ -6,6 +6,13 @@
 #include "player.hpp"
 #include "creature.hpp"
 #include "entity_manager.hpp"
+#include "json_writer.hpp"
+#include "save_data.hpp"
+#include "save_writer.hpp"
+#include "world_overlay.hpp"
+#include "event_bus.hpp"
+#include "trace.hpp"
+#include "alloc_stats.hpp"
 
 Player::Player(std::string name, int hp, int strength, int agility, double evasion,
 	unsigned int xp, unsigned int level, std::string className) :
@@ -13,16 +20,21 @@ Player::Player(std::string name, int hp, int strength, int agility, double evasi
 {
 	this->level = level;
 	this->className = className;
+	this->moves = 0;
 }
 
 Player::Player() : Player::Player("", 0, 0, 0, 0.0, 0, 1, "nullid")
 {
 }
 
-Player::Player(JsonBox::Value& saveData, JsonBox::Value& areaData, EntityManager* mgr) : Player::Player()
+Player::Player(JsonBox::Value& saveData, JsonBox::Value& areaData, WorldOverlay& world) : Player::Player()
+{
+	this->load(saveData, world.mgr);
+	this->loadArea(areaData, world);
+}
+
+Player::Player(SaveData& data, WorldOverlay& world) : Player::Player(data.player, data.areas, world)
 {
-	this->load(saveData, mgr);
-	this->loadArea(areaData, mgr);
 }
 
 // Calculates the total experience required to reach a certain level
@@ -33,7 +45,7 @@ unsigned int Player::xpToLevel(unsigned int level)
 
 // Level the player to the next level if it has enough experience
 // to do so, returning true if it could level up and false otherwise.
-bool Player::levelUp()
+bool Player::levelUp(std::ostream& out, EventBus* events)
 {
 	// Can't level up if there's not enough experience
 	if(this->xp < xpToLevel(this->level+1))
@@ -70,11 +82,12 @@ bool Player::levelUp()
 
 	// Tell the user that they grew a level, what the increases were
 	// and what their stats are now
-	std::cout << this->name << " grew to level " << level << "!\n";
-	std::cout << "Health   +" << statIncreases[0] << " -> " << this->maxHp << std::endl;
-	std::cout << "Strength +" << statIncreases[1] << " -> " << this->strength << std::endl;
-	std::cout << "Agility  +" << statIncreases[2] << " -> " << this->agility << std::endl;
-	std::cout << "----------------\n";
+	out << this->name << " grew to level " << level << "!\n";
+	out << "Health   +" << statIncreases[0] << " -> " << this->maxHp << "\n";
+	out << "Strength +" << statIncreases[1] << " -> " << this->strength << "\n";
+	out << "Agility  +" << statIncreases[2] << " -> " << this->agility << "\n";
+	out << "----------------\n";
+	if(events) events->publish(GameEvent(GameEventType::LEVEL_UP, this->name, "", this->level));
 
 	return true;
 }
@@ -85,27 +98,109 @@ JsonBox::Object Player::toJson()
 
 	o["className"] = JsonBox::Value(this->className);
 	o["level"] = JsonBox::Value(int(this->level));
+	o["current_area"] = JsonBox::Value(this->currentArea);
+	o["moves"] = JsonBox::Value(int(this->moves));
 
 	return o;
 }
 
-void Player::save(EntityManager* mgr)
+void Player::writeJsonMembers(JsonWriter& out)
+{
+	Creature::writeJsonMembers(out);
+
+	out.key("className");
+	out.value(this->className);
+	out.key("level");
+	out.value(this->level);
+	out.key("current_area");
+	out.value(this->currentArea);
+	out.key("moves");
+	out.value(this->moves);
+
+	return;
+}
+
+SaveData Player::snapshot(WorldOverlay& world, SaveFormat format, unsigned int journalSegment)
 {
+	JsonWriter out;
+
+	return this->snapshot(world, out, format, journalSegment);
+}
+
+SaveData Player::snapshot(WorldOverlay& world, JsonWriter& out, SaveFormat format, unsigned int journalSegment)
+{
+	SaveData data;
+	data.name = this->name;
+	data.format = format;
+	data.journalSegment = journalSegment;
+
+	if(format == SaveFormat::JSON)
+	{
+		// Write the JSON text straight away instead of building Json
+		// objects that would only be turned into text later anyway. The
+		// text is copied out rather than swapped so that the writer keeps
+		// its buffer for the next snapshot
+		out.clear();
+		out.beginObject();
+		this->writeJsonMembers(out);
+		if(journalSegment > 0)
+		{
+			out.key("journal_segment");
+			out.value(journalSegment);
+		}
+		out.endObject();
+		data.playerText = out.buffer;
+
+		out.clear();
+		out.beginObject();
+		for(auto& area : this->visitedAreas)
+		{
+			out.key(area);
+			world.getArea(area)->writeJson(out, world);
+		}
+		out.endObject();
+		data.areasText = out.buffer;
+
+		return data;
+	}
+
 	// Construct JSON representation of the player
-	// and save it to a file
-	JsonBox::Value v(this->toJson());
-	v.writeToFile(this->name + ".json");
+	data.player = JsonBox::Value(this->toJson());
+	if(journalSegment > 0)
+	{
+		data.player["journal_segment"] = JsonBox::Value(int(journalSegment));
+	}
 
 	// Construct a JSON object containing the areas
-	// the player has visited 
+	// the player has visited
 	JsonBox::Object o;
 	for(auto area : this->visitedAreas)
 	{
-		o[area] = mgr->getEntity<Area>(area)->getJson();
+		o[area] = world.getArea(area)->getJson(world);
 	}
-	JsonBox::Value v2(o);
-	// Write the object to a file similar to the player data
-	v2.writeToFile(this->name + "_areas.json");
+	data.areas = JsonBox::Value(o);
+
+	return data;
+}
+
+void Player::save(WorldOverlay& world, SaveFormat format)
+{
+	TRACE_SCOPE("Player::save");
+	ALLOC_SCOPE(AllocTag::SAVE);
+
+	// Write the save straight away
+	SaveWriter::commit(this->snapshot(world, format));
+
+	return;
+}
+
+void Player::save(WorldOverlay& world, SaveWriter& writer, SaveFormat format)
+{
+	TRACE_SCOPE("Player::save");
+	ALLOC_SCOPE(AllocTag::SAVE);
+
+	// Only the snapshot is taken here, the writer does the rest
+	writer.submit(this->snapshot(world, format));
 
 	return;
 }
@@ -121,18 +216,30 @@ void Player::load(JsonBox::Value& saveData, EntityManager* mgr)
 
 	this->className = o["className"].getString();
 	this->level = o["level"].getInteger();
+	if(o.find("current_area") != o.end())
+	{
+		this->currentArea = o["current_area"].getString();
+	}
+	if(o.find("moves") != o.end())
+	{
+		this->moves = o["moves"].getInteger();
+	}
 
 	return;
 }
 
-void Player::loadArea(JsonBox::Value& areaData, EntityManager* mgr)
+void Player::loadArea(JsonBox::Value& areaData, WorldOverlay& world)
 {
 	// Load the area
 	JsonBox::Object o = areaData.getObject();
 	for(auto area : o)
 	{
 		std::string key = area.first;
-		mgr->getEntity<Area>(key)->load(area.second, mgr);
+		// Older saves store the whole area instead of just the changes
+		if(area.second.getObject().count("inventory"))
+			world.editArea(key)->load(area.second, world.mgr, &world);
+		else
+			world.editArea(key)->loadDelta(area.second, world);
 		this->visitedAreas.insert(key);
 	}
 
@@ -3,11 +3,16 @@
 
 #include <unordered_set>
 #include <string>
+#include <iostream>
 #include <JsonBox.h>
 
 #include "creature.hpp"
+#include "save_data.hpp"
+#include "save_writer.hpp"
 
 class EntityManager;
+class WorldOverlay;
+class EventBus;
 
 class Player : public Creature
 {
@@ -20,6 +25,11 @@ class Player : public Creature
 	// Level of the player
 	unsigned int level;
 
+	// Number of doors the player has gone through. Used as the game
+	// clock, so that things can happen after the player has moved around
+	// for a while
+	unsigned int moves;
+
 	// Ids of areas visited by the player
 	std::unordered_set<std::string> visitedAreas;
 
@@ -27,24 +37,48 @@ class Player : public Creature
 	Player(std::string name, int hp, int strength, int agility, double evasion,
 		unsigned int xp, unsigned int level, std::string className);
 	Player();
-	Player(JsonBox::Value& saveData, JsonBox::Value& areaData, EntityManager* mgr);
+	Player(JsonBox::Value& saveData, JsonBox::Value& areaData, WorldOverlay& world);
+	Player(SaveData& data, WorldOverlay& world);
 
 	// Calculates the total experience required to reach a certain level
 	unsigned int xpToLevel(unsigned int level);
 
 	// Level the player to the next level if it has enough experience
 	// to do so, returning true if it could level up and false otherwise.
-	bool levelUp();
+	// The new stats are shown on out, and the level reached is published
+	// on the event bus if there is one
+	bool levelUp(std::ostream& out = std::cout, EventBus* events = nullptr);
 
 	// Create a Json object representation of the player
 	JsonBox::Object toJson();
 
+	// Write the player as the members of a JSON object, without building
+	// the object first
+	void writeJsonMembers(JsonWriter& out);
+
+	// Take a snapshot of the player and the areas they have visited,
+	// ready to be written to disk in the given format. JSON snapshots are
+	// written straight to text. The journal segment is recorded in the
+	// snapshot if given
+	SaveData snapshot(WorldOverlay& world, SaveFormat format = SaveFormat::JSON,
+		unsigned int journalSegment = 0);
+
+	// Take a snapshot, writing any JSON with the given writer. Its buffer
+	// keeps its memory, so a writer kept for every snapshot of a player
+	// only has to grow once rather than every time
+	SaveData snapshot(WorldOverlay& world, JsonWriter& out, SaveFormat format = SaveFormat::JSON,
+		unsigned int journalSegment = 0);
+
 	// Save the player to a file named after them
-	void save(EntityManager* mgr);
+	void save(WorldOverlay& world, SaveFormat format = SaveFormat::JSON);
+
+	// Save the player in the background using the writer
+	void save(WorldOverlay& world, SaveWriter& writer, SaveFormat format = SaveFormat::JSON);
 
-	// Attempt to load all data from the JSON value
+	// Attempt to load all data from the JSON value. The visited areas are
+	// loaded into the player's overlay
 	void load(JsonBox::Value& saveData, EntityManager* mgr);
-	void loadArea(JsonBox::Value& areaData, EntityManager* mgr);
+	void loadArea(JsonBox::Value& areaData, WorldOverlay& world);
 };
 
 #endif /* PLAYER_HPP */
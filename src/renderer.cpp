@@ -0,0 +1,61 @@
+#include <string>
+#include <iostream>
+#include <streambuf>
+#include <cerrno>
+#include <unistd.h>
+
+#include "renderer.hpp"
+
+Renderer::int_type Renderer::overflow(int_type c)
+{
+	if(c != traits_type::eof()) this->frame.push_back(traits_type::to_char_type(c));
+
+	return traits_type::not_eof(c);
+}
+
+std::streamsize Renderer::xsputn(const char* s, std::streamsize n)
+{
+	this->frame.append(s, n);
+
+	return n;
+}
+
+int Renderer::sync()
+{
+	return 0;
+}
+
+bool Renderer::present()
+{
+	const char* data = this->frame.data();
+	std::size_t left = this->frame.size();
+	while(this->fd >= 0 && left > 0)
+	{
+		ssize_t n = ::write(this->fd, data, left);
+		if(n < 0 && errno == EINTR) continue;
+		if(n <= 0) break;
+		data += n;
+		left -= n;
+	}
+	this->frame.clear();
+
+	return left == 0 || this->fd < 0;
+}
+
+void Renderer::take(std::string& dest)
+{
+	// An empty dest just swaps memory with the frame, so nothing is copied
+	// and the frame carries on with dest's old buffer
+	if(dest.empty())
+		this->frame.swap(dest);
+	else
+		dest.append(this->frame);
+	this->frame.clear();
+
+	return;
+}
+
+Renderer::Renderer(int fd) : out(fd >= 0 ? this : nullptr)
+{
+	this->fd = fd;
+}
@@ -0,0 +1,57 @@
+#ifndef RENDERER_HPP
+#define RENDERER_HPP
+
+#include <string>
+#include <iostream>
+#include <streambuf>
+
+// Collects everything the game shows in answer to one line of input into
+// a frame, and writes the whole frame out with a single write once the
+// game is waiting again, rather than a write for every line. The frame's
+// memory is kept between frames, so once it's grown large enough showing
+// the game doesn't allocate at all. Flushing the stream, such as with
+// std::endl, does nothing, so only present decides when output happens.
+//
+// A renderer without anywhere to write to is a null sink. Its stream is
+// left without a buffer, so anything written to it is thrown away before
+// it's even formatted
+class Renderer : public std::streambuf
+{
+	private:
+
+	// What's been shown since the last frame was presented
+	std::string frame;
+
+	// File descriptor frames are written to, or -1 to throw them away
+	int fd;
+
+	protected:
+
+	// Add characters to the frame
+	int_type overflow(int_type c);
+	std::streamsize xsputn(const char* s, std::streamsize n);
+
+	// Frames are only written when presented
+	int sync();
+
+	public:
+
+	// Stream for the game to write to
+	std::ostream out;
+
+	// Write the frame to the file descriptor and start a new one. Returns
+	// false if it couldn't all be written
+	bool present();
+
+	// Move the frame onto the end of dest instead, for something that
+	// writes it out itself, such as a server waiting until a socket has
+	// room, and start a new one. If dest is empty it's swapped with the
+	// frame rather than copied
+	void take(std::string& dest);
+
+	// Constructor. Frames are written to the file descriptor, or thrown
+	// away if it's -1
+	Renderer(int fd = -1);
+};
+
+#endif /* RENDERER_HPP */
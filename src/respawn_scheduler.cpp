@@ -0,0 +1,48 @@
+#include <vector>
+#include <queue>
+#include <utility>
+
+#include "respawn_scheduler.hpp"
+#include "area.hpp"
+#include "world_overlay.hpp"
+
+void RespawnScheduler::schedule(Area* area)
+{
+	if(area->respawnAt > 0) this->pending.push(std::make_pair(area->respawnAt, area));
+
+	return;
+}
+
+void RespawnScheduler::build(WorldOverlay& world)
+{
+	for(auto area : world.editedAreas())
+	{
+		this->schedule(area);
+	}
+
+	return;
+}
+
+unsigned int RespawnScheduler::update(unsigned int now, std::vector<Area*>* respawned)
+{
+	unsigned int count = 0;
+	while(!this->pending.empty() && this->pending.top().first <= now)
+	{
+		Pending next = this->pending.top();
+		this->pending.pop();
+
+		// An area cleared again after it was scheduled has a later entry
+		// in the heap, so ignore the old one
+		if(next.second->respawnAt != next.first) continue;
+		next.second->respawn();
+		if(respawned != nullptr) respawned->push_back(next.second);
+		++count;
+	}
+
+	return count;
+}
+
+unsigned int RespawnScheduler::size()
+{
+	return this->pending.size();
+}
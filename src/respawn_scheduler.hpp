@@ -0,0 +1,44 @@
+#ifndef RESPAWN_SCHEDULER_HPP
+#define RESPAWN_SCHEDULER_HPP
+
+#include <vector>
+#include <queue>
+#include <utility>
+#include <functional>
+
+class Area;
+class WorldOverlay;
+
+// Keeps track of which areas are waiting for their creatures to come back.
+// Areas are kept in a heap ordered by when they're due, so checking for
+// respawns only looks at the areas whose time has come, however many
+// areas there are in the world
+class RespawnScheduler
+{
+	private:
+
+	// Move count each area is due to respawn at
+	typedef std::pair<unsigned int, Area*> Pending;
+	std::priority_queue<Pending, std::vector<Pending>, std::greater<Pending>> pending;
+
+	public:
+
+	// Add an area that has just been cleared. The area's respawnAt says
+	// when it's due, and nothing is added if it isn't waiting to respawn
+	void schedule(Area* area);
+
+	// Schedule every area in the overlay that's waiting to respawn, such
+	// as those loaded from a save. Shared areas are never cleared, so
+	// only the player's own copies need checking
+	void build(WorldOverlay& world);
+
+	// Respawn the creatures in every area that's due by the given move
+	// count, returning the number of areas respawned. The areas are added
+	// to respawned if it's given
+	unsigned int update(unsigned int now, std::vector<Area*>* respawned = nullptr);
+
+	// Number of areas waiting to respawn
+	unsigned int size();
+};
+
+#endif /* RESPAWN_SCHEDULER_HPP */
@@ -0,0 +1,62 @@
+#include <string>
+#include <fstream>
+#include <sstream>
+#include <JsonBox.h>
+
+#include "save_data.hpp"
+#include "binary_save.hpp"
+#include "save_store.hpp"
+
+SaveStatus SaveData::read(const std::string& name, SaveStore* store)
+{
+	this->name = name;
+
+	// Saves in the store are always binary
+	if(store != nullptr)
+	{
+		std::string bytes;
+		if(!store->read(name, bytes)) return SaveStatus::NONE;
+		if(!BinarySave::decode(bytes, *this)) return SaveStatus::UNREADABLE;
+		this->readJournalSegment();
+		return SaveStatus::LOADED;
+	}
+
+	// Prefer the binary save if there is one
+	std::ifstream f((name + ".sav").c_str(), std::ios::binary);
+	if(f.good())
+	{
+		std::stringstream ss;
+		ss << f.rdbuf();
+		if(!BinarySave::decode(ss.str(), *this)) return SaveStatus::UNREADABLE;
+		this->readJournalSegment();
+		return SaveStatus::LOADED;
+	}
+
+	// Otherwise fall back to the JSON files
+	std::ifstream g((name + ".json").c_str());
+	if(g.good())
+	{
+		g.close();
+		this->format = SaveFormat::JSON;
+		this->player.loadFromFile(name + ".json");
+		this->areas.loadFromFile(name + "_areas.json");
+		if(!this->player.isObject()) return SaveStatus::UNREADABLE;
+		this->readJournalSegment();
+		return SaveStatus::LOADED;
+	}
+
+	return SaveStatus::NONE;
+}
+
+void SaveData::parseText()
+{
+	if(!this->playerText.empty()) this->player.loadFromString(this->playerText);
+	if(!this->areasText.empty()) this->areas.loadFromString(this->areasText);
+}
+
+void SaveData::readJournalSegment()
+{
+	const JsonBox::Object& o = this->player.getObject();
+	auto it = o.find("journal_segment");
+	this->journalSegment = it == o.end() ? 0 : it->second.getInteger();
+}
@@ -0,0 +1,59 @@
+#ifndef SAVE_DATA_HPP
+#define SAVE_DATA_HPP
+
+#include <string>
+#include <JsonBox.h>
+
+class SaveStore;
+
+// Saves can either be written as a pair of human readable JSON files,
+// <name>.json and <name>_areas.json, or as a single compact binary
+// file <name>.sav
+enum class SaveFormat { JSON, BINARY };
+
+// What was found when looking for a player's save. An unreadable save is
+// corrupt, or was written by a newer version of the game, and must be
+// left alone rather than being treated as no save at all, otherwise the
+// player would start again and their save would be overwritten
+enum class SaveStatus { NONE, LOADED, UNREADABLE };
+
+// Everything needed to write a player's save files, taken at a single
+// point in time so that the player and area data always agree
+class SaveData
+{
+	public:
+
+	// Name of the player, which the save files are named after
+	std::string name;
+
+	// Format the save should be written in
+	SaveFormat format;
+
+	// Player data, the contents of <name>.json
+	JsonBox::Value player;
+
+	// Areas the player has visited, the contents of <name>_areas.json
+	JsonBox::Value areas;
+
+	// JSON snapshots are written straight to text instead of being built
+	// as values, in which case these hold the contents of the two files
+	std::string playerText;
+	std::string areasText;
+
+	// Journal segment the save was taken at, or 0 if it wasn't
+	unsigned int journalSegment;
+
+	// Read the player's save from disk in whichever format it was written
+	// in, or from the store if one is given
+	SaveStatus read(const std::string& name, SaveStore* store = nullptr);
+
+	// Parse the text of a JSON snapshot into values
+	void parseText();
+
+	// Set the journal segment from the player data
+	void readJournalSegment();
+
+	SaveData() : format(SaveFormat::JSON), journalSegment(0) {}
+};
+
+#endif /* SAVE_DATA_HPP */
@@ -0,0 +1,440 @@
+#include <string>
+#include <map>
+#include <vector>
+#include <mutex>
+#include <algorithm>
+#include <cstdint>
+#include <fcntl.h>
+#include <unistd.h>
+#include <sys/file.h>
+
+#include "save_store.hpp"
+#include "binary_io.hpp"
+
+static const unsigned int storeVersion = 1;
+
+// Header copies live in the first two pages
+static const uint64_t headerPages = 2;
+
+// Read exactly size bytes at the offset, returning false if the file
+// is too short
+static bool readAt(int fd, uint64_t offset, std::string& bytes, uint64_t size)
+{
+	bytes.resize(size);
+	uint64_t done = 0;
+	while(done < size)
+	{
+		ssize_t n = pread(fd, &bytes[done], size - done, offset + done);
+		if(n <= 0) return false;
+		done += n;
+	}
+	return true;
+}
+
+// Frames are a length prefixed block of bytes followed by a checksum,
+// used for the header and index
+static std::string frame(const std::string& body)
+{
+	ByteWriter out;
+	out.putString(body);
+	out.putFixed32(checksum(body));
+	return out.bytes;
+}
+
+static bool unframe(const std::string& bytes, std::string& body)
+{
+	ByteReader in(bytes);
+	body = in.getString();
+	uint32_t sum = in.getFixed32();
+	return in.good && sum == checksum(body);
+}
+
+uint64_t SaveStore::allocate(uint64_t pages)
+{
+	// Take the first free run that is big enough, putting back whatever
+	// is left over
+	for(auto it = this->freePages.begin(); it != this->freePages.end(); ++it)
+	{
+		if(it->second < pages) continue;
+		uint64_t page = it->first;
+		uint64_t left = it->second - pages;
+		this->freePages.erase(it);
+		if(left > 0) this->freePages[page + pages] = left;
+		return page;
+	}
+
+	// Otherwise grow the file
+	uint64_t page = this->pageCount;
+	this->pageCount += pages;
+	return page;
+}
+
+void SaveStore::release(uint64_t page, uint64_t pages)
+{
+	if(pages == 0) return;
+
+	// Merge with the following run
+	auto next = this->freePages.find(page + pages);
+	if(next != this->freePages.end())
+	{
+		pages += next->second;
+		this->freePages.erase(next);
+	}
+
+	// And with the preceding one
+	auto prev = this->freePages.lower_bound(page);
+	if(prev != this->freePages.begin())
+	{
+		--prev;
+		if(prev->first + prev->second == page)
+		{
+			prev->second += pages;
+			return;
+		}
+	}
+	this->freePages[page] = pages;
+
+	return;
+}
+
+bool SaveStore::writePages(uint64_t page, const std::string& bytes)
+{
+	uint64_t done = 0;
+	while(done < bytes.size())
+	{
+		ssize_t n = pwrite(this->fd, bytes.data() + done, bytes.size() - done,
+			page * pageSize + done);
+		if(n <= 0) return false;
+		done += n;
+	}
+	return true;
+}
+
+bool SaveStore::writeIndex()
+{
+	ByteWriter body;
+	body.putVarint(this->index.size());
+	for(auto& entry : this->index)
+	{
+		body.putString(entry.first);
+		body.putVarint(entry.second.page);
+		body.putVarint(entry.second.pages);
+		body.putVarint(entry.second.length);
+		body.putFixed32(entry.second.checksum);
+	}
+	std::string bytes = frame(body.bytes);
+
+	uint64_t pages = (bytes.size() + pageSize - 1) / pageSize;
+	uint64_t page = this->allocate(pages);
+	if(!this->writePages(page, bytes) || fdatasync(this->fd) != 0) return false;
+
+	this->indexPage = page;
+	this->indexPages = pages;
+	this->recent.clear();
+
+	return true;
+}
+
+bool SaveStore::writeHeader()
+{
+	uint64_t oldIndexPage = this->indexPage;
+	uint64_t oldIndexPages = this->indexPages;
+	bool rewroteIndex = false;
+
+	std::string bytes;
+	while(true)
+	{
+		ByteWriter body;
+		body.bytes = "RPGDB";
+		body.putVarint(storeVersion);
+		body.putVarint(this->seq + 1);
+		body.putVarint(this->pageCount);
+		body.putVarint(this->indexPage);
+		body.putVarint(this->indexPages);
+		body.putVarint(this->recent.size());
+		for(auto& name : this->recent)
+		{
+			// Deleted saves are written with no pages
+			auto it = this->index.find(name);
+			Entry entry = it == this->index.end() ? Entry() : it->second;
+			if(it == this->index.end()) entry.pages = 0;
+			body.putString(name);
+			body.putVarint(entry.pages == 0 ? 0 : entry.page);
+			body.putVarint(entry.pages);
+			body.putVarint(entry.pages == 0 ? 0 : entry.length);
+			body.putFixed32(entry.pages == 0 ? 0 : entry.checksum);
+		}
+		bytes = frame(body.bytes);
+		if(bytes.size() <= pageSize || rewroteIndex) break;
+
+		// Too many recent saves to fit, so rewrite the index instead.
+		// The index might need more pages, which changes the page count
+		// in the header, so go round again
+		if(!this->writeIndex()) return false;
+		rewroteIndex = true;
+	}
+
+	uint64_t slot = (this->seq + 1) % headerPages;
+	if(!this->writePages(slot, bytes) || fdatasync(this->fd) != 0) return false;
+	++this->seq;
+
+	// The old index isn't referenced by the new header, so can be reused
+	if(rewroteIndex) this->release(oldIndexPage, oldIndexPages);
+
+	return true;
+}
+
+bool SaveStore::open()
+{
+	// Find the newest valid header
+	bool found = false;
+	std::string best;
+	for(uint64_t slot = 0; slot < headerPages; ++slot)
+	{
+		std::string bytes, body;
+		readAt(this->fd, slot * pageSize, bytes, pageSize);
+		if(!unframe(bytes, body) || body.compare(0, 5, "RPGDB") != 0) continue;
+
+		ByteReader in(body);
+		in.skip(5);
+		if(in.getVarint() > storeVersion) continue;
+		uint64_t seq = in.getVarint();
+		if(!found || seq > this->seq)
+		{
+			found = true;
+			this->seq = seq;
+			best = body;
+		}
+	}
+	if(!found) return false;
+
+	ByteReader in(best);
+	in.skip(5);
+	in.getVarint();
+	in.getVarint();
+	this->pageCount = in.getVarint();
+	this->indexPage = in.getVarint();
+	this->indexPages = in.getVarint();
+
+	// Load the index
+	this->index.clear();
+	if(this->indexPages > 0)
+	{
+		std::string bytes, body;
+		readAt(this->fd, this->indexPage * pageSize, bytes, this->indexPages * pageSize);
+		if(!unframe(bytes, body)) return false;
+		ByteReader indexIn(body);
+		uint64_t size = indexIn.getVarint();
+		for(uint64_t i = 0; i < size && indexIn.good; ++i)
+		{
+			std::string name = indexIn.getString();
+			Entry& entry = this->index[name];
+			entry.page = indexIn.getVarint();
+			entry.pages = indexIn.getVarint();
+			entry.length = indexIn.getVarint();
+			entry.checksum = indexIn.getFixed32();
+		}
+		if(!indexIn.good) return false;
+	}
+
+	// Saves written since then take precedence
+	this->recent.clear();
+	uint64_t numRecent = in.getVarint();
+	for(uint64_t i = 0; i < numRecent && in.good; ++i)
+	{
+		std::string name = in.getString();
+		Entry entry;
+		entry.page = in.getVarint();
+		entry.pages = in.getVarint();
+		entry.length = in.getVarint();
+		entry.checksum = in.getFixed32();
+		if(entry.pages == 0)
+			this->index.erase(name);
+		else
+			this->index[name] = entry;
+		this->recent.push_back(name);
+	}
+	if(!in.good) return false;
+
+	// Anything not used by a save or the index is free
+	std::vector<std::pair<uint64_t, uint64_t>> used;
+	used.push_back(std::make_pair(this->indexPage, this->indexPages));
+	for(auto& entry : this->index)
+	{
+		used.push_back(std::make_pair(entry.second.page, entry.second.pages));
+	}
+	std::sort(used.begin(), used.end());
+	this->freePages.clear();
+	uint64_t page = headerPages;
+	for(auto& run : used)
+	{
+		if(run.second == 0) continue;
+		if(run.first > page) this->freePages[page] = run.first - page;
+		page = std::max(page, run.first + run.second);
+	}
+	if(this->pageCount > page) this->freePages[page] = this->pageCount - page;
+
+	return true;
+}
+
+bool SaveStore::find(const std::string& name, Entry& entry)
+{
+	if(this->fd < 0) return false;
+
+	std::lock_guard<std::mutex> lock(this->indexMutex);
+	auto it = this->index.find(name);
+	if(it == this->index.end()) return false;
+	entry = it->second;
+
+	return true;
+}
+
+bool SaveStore::write(const std::string& name, const std::string& bytes)
+{
+	std::lock_guard<std::mutex> lock(this->writeMutex);
+	if(this->fd < 0) return false;
+
+	// Write the save into free pages and make sure it's on disk before
+	// the header is changed to point at it
+	Entry entry;
+	entry.pages = std::max<uint64_t>(1, (bytes.size() + pageSize - 1) / pageSize);
+	entry.page = this->allocate(entry.pages);
+	entry.length = bytes.size();
+	entry.checksum = checksum(bytes);
+	if(!this->writePages(entry.page, bytes) || fdatasync(this->fd) != 0)
+	{
+		this->release(entry.page, entry.pages);
+		return false;
+	}
+
+	Entry old;
+	bool replaced = false;
+	{
+		std::lock_guard<std::mutex> indexLock(this->indexMutex);
+		auto it = this->index.find(name);
+		if(it != this->index.end())
+		{
+			old = it->second;
+			replaced = true;
+		}
+		this->index[name] = entry;
+	}
+	if(std::find(this->recent.begin(), this->recent.end(), name) == this->recent.end())
+		this->recent.push_back(name);
+
+	if(!this->writeHeader()) return false;
+
+	// The old save's pages can only be reused once nothing points at them
+	if(replaced) this->release(old.page, old.pages);
+
+	return true;
+}
+
+bool SaveStore::read(const std::string& name, std::string& bytes)
+{
+	// The pages might be reused by the writer whilst we're reading them,
+	// in which case the checksum won't match and the index will have
+	// changed, so look the save up again and retry
+	for(int attempt = 0; attempt < 8; ++attempt)
+	{
+		Entry entry;
+		if(!this->find(name, entry)) return false;
+		if(readAt(this->fd, entry.page * pageSize, bytes, entry.length) &&
+			checksum(bytes) == entry.checksum)
+		{
+			return true;
+		}
+	}
+
+	return false;
+}
+
+bool SaveStore::exists(const std::string& name)
+{
+	Entry entry;
+	return this->find(name, entry);
+}
+
+bool SaveStore::remove(const std::string& name)
+{
+	std::lock_guard<std::mutex> lock(this->writeMutex);
+
+	Entry old;
+	{
+		std::lock_guard<std::mutex> indexLock(this->indexMutex);
+		auto it = this->index.find(name);
+		if(it == this->index.end()) return false;
+		old = it->second;
+		this->index.erase(it);
+	}
+	if(std::find(this->recent.begin(), this->recent.end(), name) == this->recent.end())
+		this->recent.push_back(name);
+
+	if(!this->writeHeader()) return false;
+	this->release(old.page, old.pages);
+
+	return true;
+}
+
+unsigned int SaveStore::size()
+{
+	std::lock_guard<std::mutex> lock(this->indexMutex);
+	return this->index.size();
+}
+
+SaveStore::SaveStore(const std::string& filename)
+{
+	this->pageCount = headerPages;
+	this->indexPage = 0;
+	this->indexPages = 0;
+	this->seq = 0;
+
+	this->fd = ::open(filename.c_str(), O_RDWR | O_CREAT, 0644);
+	if(this->fd < 0)
+	{
+		this->error = "Couldn't open " + filename;
+		return;
+	}
+
+	// Only one process can use the store at a time, since each keeps its
+	// own copy of the index and they would overwrite each other's pages
+	if(flock(this->fd, LOCK_EX | LOCK_NB) != 0)
+	{
+		close(this->fd);
+		this->fd = -1;
+		this->error = filename + " is being used by another game";
+		return;
+	}
+
+	// A new store just needs a header. An existing one that can't be read
+	// is left alone rather than being overwritten, and every operation on
+	// it will fail
+	if(lseek(this->fd, 0, SEEK_END) == 0)
+	{
+		if(!this->writeHeader()) this->error = "Couldn't write to " + filename;
+	}
+	else if(!this->open())
+	{
+		this->error = filename + " is damaged and can't be read";
+	}
+	if(!this->error.empty())
+	{
+		close(this->fd);
+		this->fd = -1;
+	}
+}
+
+bool SaveStore::good()
+{
+	return this->fd >= 0;
+}
+
+const std::string& SaveStore::getError()
+{
+	return this->error;
+}
+
+SaveStore::~SaveStore()
+{
+	if(this->fd >= 0) close(this->fd);
+}
@@ -0,0 +1,133 @@
+#ifndef SAVE_STORE_HPP
+#define SAVE_STORE_HPP
+
+#include <string>
+#include <map>
+#include <vector>
+#include <mutex>
+#include <cstdint>
+
+// Keeps every player's save in a single file, rather than each player
+// having their own pair of files. The file is split into fixed size pages,
+// and each save is stored in a run of consecutive pages. An index from
+// player name to page run is kept in memory and on disk, so finding a
+// save doesn't depend on how many other players there are. Pages freed
+// when a save is replaced are reused for later saves.
+//
+// The first two pages hold alternating copies of the header, which says
+// where the on disk index is and lists any saves written since the index
+// was last rewritten. A new save is written to free pages and synced
+// before the header pointing at it is written, so a crash leaves either
+// the old header or the new one, and either way every save it points to
+// is complete. Backing up the store only requires copying the file.
+//
+// Any number of threads can read saves whilst one writes
+class SaveStore
+{
+	public:
+
+	static const uint64_t pageSize = 4096;
+
+	private:
+
+	// Where a save lives in the file
+	class Entry
+	{
+		public:
+
+		// First page and number of pages used
+		uint64_t page;
+		uint64_t pages;
+
+		// Size of the save in bytes, and its checksum which readers use
+		// to check the pages weren't reused whilst they were reading them
+		uint64_t length;
+		uint32_t checksum;
+	};
+
+	int fd;
+
+	// Why the store couldn't be opened, or empty if it was
+	std::string error;
+
+	// Index of saves by player name
+	std::map<std::string, Entry> index;
+
+	// Names of saves written since the on disk index was last rewritten
+	std::vector<std::string> recent;
+
+	// Free page runs, by first page
+	std::map<uint64_t, uint64_t> freePages;
+
+	// Number of pages in the file
+	uint64_t pageCount;
+
+	// Where the on disk index is
+	uint64_t indexPage;
+	uint64_t indexPages;
+
+	// Incremented with every header written. The copy of the header with
+	// the highest number is the current one
+	uint64_t seq;
+
+	// Held by the writer whilst it changes the file, and briefly by
+	// readers whilst they look up a save in the index
+	std::mutex writeMutex;
+	std::mutex indexMutex;
+
+	// Find a run of free pages, extending the file if there isn't one
+	uint64_t allocate(uint64_t pages);
+
+	// Return a run of pages to the free list, merging it with its neighbours
+	void release(uint64_t page, uint64_t pages);
+
+	// Write the bytes starting at the given page
+	bool writePages(uint64_t page, const std::string& bytes);
+
+	// Write the index to new pages, freeing the old ones
+	bool writeIndex();
+
+	// Write the header into the next slot and sync it. If the list of
+	// recent saves won't fit then the index is rewritten first
+	bool writeHeader();
+
+	// Read the header and index, returning false if there isn't a valid one
+	bool open();
+
+	// Look up a save, returning false if it doesn't exist
+	bool find(const std::string& name, Entry& entry);
+
+	public:
+
+	// Write the save for the player, replacing any old one
+	bool write(const std::string& name, const std::string& bytes);
+
+	// Read the player's save, returning false if they don't have one
+	bool read(const std::string& name, std::string& bytes);
+
+	// True if the player has a save
+	bool exists(const std::string& name);
+
+	// Delete the player's save
+	bool remove(const std::string& name);
+
+	// Number of saves in the store
+	unsigned int size();
+
+	// True if the store was opened. If it wasn't, every operation on it
+	// fails, so the game mustn't be played with it
+	bool good();
+
+	// Why the store couldn't be opened
+	const std::string& getError();
+
+	// Open the store, creating it if it doesn't exist. The store is locked
+	// until it's closed, so that no other process can use it at the same
+	// time
+	SaveStore(const std::string& filename);
+
+	// Destructor
+	~SaveStore();
+};
+
+#endif /* SAVE_STORE_HPP */
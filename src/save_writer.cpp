@@ -0,0 +1,333 @@
+#include <string>
+#include <sstream>
+#include <fstream>
+#include <cstdio>
+#include <map>
+#include <vector>
+#include <thread>
+#include <mutex>
+#include <condition_variable>
+#include <chrono>
+#include <iostream>
+#include <fcntl.h>
+#include <unistd.h>
+#include <JsonBox.h>
+
+#include "save_writer.hpp"
+#include "save_data.hpp"
+#include "binary_save.hpp"
+#include "journal.hpp"
+#include "save_store.hpp"
+#include "trace.hpp"
+#include "alloc_stats.hpp"
+
+// Write the string to the file and make sure it has reached the disk
+// before returning
+static bool writeFileSynced(const std::string& filename, const std::string& contents)
+{
+	int fd = open(filename.c_str(), O_WRONLY | O_CREAT | O_TRUNC, 0644);
+	if(fd < 0) return false;
+
+	size_t written = 0;
+	while(written < contents.size())
+	{
+		ssize_t n = write(fd, contents.data() + written, contents.size() - written);
+		if(n < 0)
+		{
+			close(fd);
+			return false;
+		}
+		written += n;
+	}
+
+	bool ok = fsync(fd) == 0;
+	return close(fd) == 0 && ok;
+}
+
+// Renames are only durable once the directory containing the files
+// has been synced too. Saves live in the working directory
+static void syncDirectory()
+{
+	int fd = open(".", O_RDONLY);
+	if(fd < 0) return;
+	fsync(fd);
+	close(fd);
+}
+
+static bool fileExists(const std::string& filename)
+{
+	std::ifstream f(filename.c_str());
+	return f.good();
+}
+
+static std::string toString(const JsonBox::Value& v)
+{
+	std::ostringstream ss;
+	v.writeToStream(ss);
+	return ss.str();
+}
+
+// If the save was taken by compacting the journal, the segments before
+// the one it was taken at are now part of the save and can be deleted
+static void removeJournalSegments(const SaveData& data)
+{
+	unsigned int segment = Journal::savedSegment(data);
+	if(segment > 0) Journal::removeSegmentsBefore(data.name, segment);
+}
+
+// A JSON commit writes both files to temporaries, then creates a marker
+// file before renaming the temporaries over the real files. If the marker
+// exists then both temporaries are known to be complete, so an interrupted
+// commit can always be finished. If it doesn't then the old files haven't
+// been touched yet and the temporaries can be thrown away. Binary saves
+// are a single file, so a plain rename is enough.
+// Once the new save is in place any save in the other format is out of
+// date, so it's removed to stop it being loaded instead, and so are the
+// journal segments the save includes. Neither is touched unless the new
+// save is in place, so a failed commit never loses anything. The store
+// takes care of writing atomically itself
+bool SaveWriter::commit(const SaveData& data, SaveStore* store)
+{
+	TRACE_SCOPE("SaveWriter::commit");
+	ALLOC_SCOPE(AllocTag::SAVE);
+
+	if(store != nullptr)
+	{
+		if(!store->write(data.name, BinarySave::encode(data))) return false;
+		removeJournalSegments(data);
+
+		return true;
+	}
+
+	std::string playerFile = data.name + ".json";
+	std::string areasFile = data.name + "_areas.json";
+	std::string binaryFile = data.name + ".sav";
+	std::string marker = data.name + ".commit";
+
+	if(data.format == SaveFormat::BINARY)
+	{
+		if(!writeFileSynced(binaryFile + ".tmp", BinarySave::encode(data))) return false;
+		if(std::rename((binaryFile + ".tmp").c_str(), binaryFile.c_str()) != 0)
+		{
+			// The old save is untouched, so it's still the one to load
+			std::remove((binaryFile + ".tmp").c_str());
+			return false;
+		}
+		syncDirectory();
+
+		// A marker left by a failed JSON commit would have recovering
+		// replace this save with the older JSON one, so it goes first
+		std::remove(marker.c_str());
+		syncDirectory();
+		std::remove(playerFile.c_str());
+		std::remove(areasFile.c_str());
+		syncDirectory();
+		removeJournalSegments(data);
+
+		return true;
+	}
+
+	// Snapshots are usually already text
+	std::string playerText = data.playerText.empty() ? toString(data.player) : data.playerText;
+	std::string areasText = data.areasText.empty() ? toString(data.areas) : data.areasText;
+
+	// A marker left by a failed commit says the temporaries are complete,
+	// which stops being true as soon as they're rewritten below, so it has
+	// to be gone from the disk first
+	if(fileExists(marker))
+	{
+		if(std::remove(marker.c_str()) != 0) return false;
+		syncDirectory();
+	}
+	if(!writeFileSynced(playerFile + ".tmp", playerText)) return false;
+	if(!writeFileSynced(areasFile + ".tmp", areasText)) return false;
+	if(!writeFileSynced(marker, "")) return false;
+	syncDirectory();
+
+	// If a rename fails the marker is left behind, so that recovering
+	// finishes the commit from the complete temporaries later. Nothing
+	// else is removed until the new save is in place
+	if(std::rename((areasFile + ".tmp").c_str(), areasFile.c_str()) != 0) return false;
+	if(std::rename((playerFile + ".tmp").c_str(), playerFile.c_str()) != 0) return false;
+	syncDirectory();
+
+	std::remove(binaryFile.c_str());
+	std::remove(marker.c_str());
+	syncDirectory();
+	removeJournalSegments(data);
+
+	return true;
+}
+
+void SaveWriter::recover(const std::string& name)
+{
+	std::string playerFile = name + ".json";
+	std::string areasFile = name + "_areas.json";
+	std::string marker = name + ".commit";
+
+	if(fileExists(marker))
+	{
+		// The commit got as far as the renames, so finish them off. Only
+		// once they've all worked is the old save out of date
+		bool renamed = true;
+		if(fileExists(areasFile + ".tmp"))
+			renamed = std::rename((areasFile + ".tmp").c_str(), areasFile.c_str()) == 0 && renamed;
+		if(fileExists(playerFile + ".tmp"))
+			renamed = std::rename((playerFile + ".tmp").c_str(), playerFile.c_str()) == 0 && renamed;
+		syncDirectory();
+		if(renamed)
+		{
+			std::remove((name + ".sav").c_str());
+			std::remove(marker.c_str());
+		}
+	}
+	else
+	{
+		// The commit never started replacing files, so the old save is
+		// intact and any temporaries are incomplete
+		std::remove((playerFile + ".tmp").c_str());
+		std::remove((areasFile + ".tmp").c_str());
+	}
+	std::remove((name + ".sav.tmp").c_str());
+	syncDirectory();
+
+	return;
+}
+
+void SaveWriter::run()
+{
+	// Files being synced, kept so the list doesn't have to grow each time
+	std::vector<int> files;
+
+	std::unique_lock<std::mutex> lock(this->mutex);
+	while(true)
+	{
+		this->cv.wait(lock, [this]()
+		{
+			return this->stopping || !this->pending.empty() || !this->syncs.empty();
+		});
+		if(this->pending.empty() && this->syncs.empty()) break;
+
+		// Syncs are quick next to commits, so they're done first, all of
+		// them in one go
+		if(!this->syncs.empty())
+		{
+			files.swap(this->syncs);
+			this->busy = true;
+			lock.unlock();
+
+			for(auto fd : files)
+			{
+				fdatasync(fd);
+				close(fd);
+			}
+			files.clear();
+
+			lock.lock();
+			this->busy = false;
+			this->cv.notify_all();
+			continue;
+		}
+
+		// Take a snapshot off the queue and write it without holding the
+		// lock, so the game can keep submitting saves in the meantime
+		SaveData data = std::move(this->pending.begin()->second);
+		this->pending.erase(this->pending.begin());
+		this->busy = true;
+		this->committing = data.name;
+		lock.unlock();
+
+		// The disk might only be full or busy for a moment, so try again a
+		// few times before giving up. There's no point once a newer save
+		// of the same player is waiting, since that replaces this one
+		bool committed = false;
+		for(unsigned int attempt = 1; ; ++attempt)
+		{
+			committed = commit(data, this->store);
+			if(committed || attempt == maxAttempts) break;
+			std::this_thread::sleep_for(std::chrono::milliseconds(100 * attempt));
+			std::lock_guard<std::mutex> check(this->mutex);
+			if(this->pending.count(data.name)) break;
+		}
+		if(!committed)
+		{
+			std::cerr << "Couldn't save " << data.name << "\n";
+		}
+
+		lock.lock();
+		if(!committed) ++this->failed;
+		this->busy = false;
+		this->committing.clear();
+		this->cv.notify_all();
+	}
+
+	return;
+}
+
+void SaveWriter::submit(SaveData data)
+{
+	std::lock_guard<std::mutex> lock(this->mutex);
+	std::string name = data.name;
+	this->pending[name] = std::move(data);
+	this->cv.notify_all();
+
+	return;
+}
+
+void SaveWriter::sync(int fd)
+{
+	std::lock_guard<std::mutex> lock(this->mutex);
+	this->syncs.push_back(fd);
+	this->cv.notify_all();
+
+	return;
+}
+
+void SaveWriter::flush()
+{
+	std::unique_lock<std::mutex> lock(this->mutex);
+	this->cv.wait(lock, [this]()
+	{
+		return this->pending.empty() && this->syncs.empty() && !this->busy;
+	});
+
+	return;
+}
+
+void SaveWriter::flush(const std::string& name)
+{
+	std::unique_lock<std::mutex> lock(this->mutex);
+	this->cv.wait(lock, [this, &name]()
+	{
+		return !this->pending.count(name) && !(this->busy && this->committing == name);
+	});
+
+	return;
+}
+
+unsigned int SaveWriter::numFailed()
+{
+	std::lock_guard<std::mutex> lock(this->mutex);
+
+	return this->failed;
+}
+
+SaveWriter::SaveWriter(SaveStore* store)
+{
+	this->store = store;
+	this->busy = false;
+	this->failed = 0;
+	this->stopping = false;
+	this->thread = std::thread(&SaveWriter::run, this);
+}
+
+SaveWriter::~SaveWriter()
+{
+	// The writer thread empties the queue before it stops
+	{
+		std::lock_guard<std::mutex> lock(this->mutex);
+		this->stopping = true;
+		this->cv.notify_all();
+	}
+	this->thread.join();
+}
@@ -0,0 +1,102 @@
+#ifndef SAVE_WRITER_HPP
+#define SAVE_WRITER_HPP
+
+#include <string>
+#include <map>
+#include <vector>
+#include <thread>
+#include <mutex>
+#include <condition_variable>
+#include <JsonBox.h>
+
+#include "save_data.hpp"
+
+class SaveStore;
+
+// Writing the save files can take a while, so instead of making the game
+// wait for the disk the game hands a snapshot of the save to the writer,
+// which serialises and writes it on its own thread. Files the game only
+// needs synced, such as journals, are handed over the same way
+class SaveWriter
+{
+	private:
+
+	// Snapshots waiting to be written, keyed by player name. If a player
+	// is saved again before their last snapshot has been written then the
+	// old snapshot is simply replaced, so back-to-back saves only cost
+	// one write
+	std::map<std::string, SaveData> pending;
+
+	// Store that saves are written to, or nullptr if they're written to
+	// their own files
+	SaveStore* store;
+
+	// Files waiting to be synced. Each is a descriptor of its own, which
+	// is closed once the file has been synced
+	std::vector<int> syncs;
+
+	// True whilst the writer thread is committing a snapshot, and the
+	// name of the player it belongs to
+	bool busy;
+	std::string committing;
+
+	// Number of snapshots that couldn't be written, even after trying
+	// again
+	unsigned int failed;
+
+	// Number of times a snapshot is tried before it's given up on
+	static const unsigned int maxAttempts = 3;
+
+	// Set by the destructor to tell the writer thread to finish up
+	bool stopping;
+
+	std::mutex mutex;
+	std::condition_variable cv;
+	std::thread thread;
+
+	// Body of the writer thread
+	void run();
+
+	public:
+
+	// Queue a snapshot to be written. Returns immediately
+	void submit(SaveData data);
+
+	// Sync the file and then close the descriptor, on the writer thread.
+	// Files handed over whilst the writer is busy are all synced together
+	// once it's free. Returns immediately
+	void sync(int fd);
+
+	// Block until every submitted snapshot has been written, and every
+	// file handed over has been synced
+	void flush();
+
+	// Block until every snapshot of the named player has been written, so
+	// that their save files can be read, or tidied up, without a commit
+	// changing them at the same time
+	void flush(const std::string& name);
+
+	// Number of snapshots that couldn't be written. Each one is also
+	// reported on stderr
+	unsigned int numFailed();
+
+	// Write the snapshot to disk in its format, replacing the old save
+	// files. Either all of the files are replaced or none of them are, even
+	// if the program crashes part way through. If a store is given then the
+	// snapshot is written to that in the binary format instead. Returns
+	// false if the save could not be written
+	static bool commit(const SaveData& data, SaveStore* store = nullptr);
+
+	// Tidy up after a commit that was interrupted by a crash, either by
+	// finishing it or by throwing away the half written files. Should be
+	// called before trying to load the player's save
+	static void recover(const std::string& name);
+
+	// Constructor. Saves are written to the store if one is given
+	SaveWriter(SaveStore* store = nullptr);
+
+	// Destructor. Writes any outstanding snapshots before returning
+	~SaveWriter();
+};
+
+#endif /* SAVE_WRITER_HPP */
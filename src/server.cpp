@@ -0,0 +1,237 @@
+#include <string>
+#include <vector>
+#include <memory>
+#include <atomic>
+#include <thread>
+#include <algorithm>
+#include <cstring>
+#include <cstdlib>
+#include <cerrno>
+#include <unistd.h>
+#include <fcntl.h>
+#include <poll.h>
+#include <sys/types.h>
+#include <sys/socket.h>
+#include <sys/un.h>
+#include <netinet/in.h>
+#include <arpa/inet.h>
+
+#include "server.hpp"
+#include "session.hpp"
+
+// A player who stops reading can't make the server hold on to more than
+// this much output for them
+static const std::size_t maxOutput = 1 << 20;
+
+static void setNonBlocking(int fd)
+{
+	::fcntl(fd, F_SETFL, ::fcntl(fd, F_GETFL, 0) | O_NONBLOCK);
+
+	return;
+}
+
+Server::Connection::Connection(int fd, SessionContext* context) : screen(fd)
+{
+	this->fd = fd;
+	this->closing = false;
+	this->session.reset(new Session(context, this->screen.out));
+}
+
+bool Server::listen(const std::string& address)
+{
+	if(address.find('/') != std::string::npos)
+	{
+		sockaddr_un addr;
+		std::memset(&addr, 0, sizeof(addr));
+		addr.sun_family = AF_UNIX;
+		if(address.size() >= sizeof(addr.sun_path)) return false;
+		std::strcpy(addr.sun_path, address.c_str());
+
+		// Remove the socket left behind by an earlier server
+		::unlink(address.c_str());
+		this->listenFd = ::socket(AF_UNIX, SOCK_STREAM, 0);
+		if(this->listenFd < 0) return false;
+		if(::bind(this->listenFd, (sockaddr*)&addr, sizeof(addr)) != 0) return false;
+	}
+	else
+	{
+		sockaddr_in addr;
+		std::memset(&addr, 0, sizeof(addr));
+		addr.sin_family = AF_INET;
+		addr.sin_port = htons(std::atoi(address.c_str()));
+		addr.sin_addr.s_addr = htonl(INADDR_LOOPBACK);
+
+		this->listenFd = ::socket(AF_INET, SOCK_STREAM, 0);
+		if(this->listenFd < 0) return false;
+		int reuse = 1;
+		::setsockopt(this->listenFd, SOL_SOCKET, SO_REUSEADDR, &reuse, sizeof(reuse));
+		if(::bind(this->listenFd, (sockaddr*)&addr, sizeof(addr)) != 0) return false;
+	}
+
+	// Every worker waits for connections, so whichever wakes up first
+	// takes it and the rest mustn't block
+	setNonBlocking(this->listenFd);
+
+	return ::listen(this->listenFd, SOMAXCONN) == 0;
+}
+
+void Server::accept(std::vector<std::unique_ptr<Connection>>& connections)
+{
+	int fd = ::accept(this->listenFd, nullptr, nullptr);
+	if(fd < 0) return;
+
+	if(++this->numSessions > this->maxSessions)
+	{
+		--this->numSessions;
+		const char message[] = "The server is full, try again later.\n";
+		::send(fd, message, sizeof(message) - 1, MSG_NOSIGNAL);
+		::close(fd);
+		return;
+	}
+
+	setNonBlocking(fd);
+	connections.push_back(std::unique_ptr<Connection>(new Connection(fd, this->context)));
+	Connection& connection = *connections.back();
+	connection.screen.take(connection.output);
+	this->send(connection);
+
+	return;
+}
+
+void Server::receive(Connection& connection)
+{
+	char buf[4096];
+	ssize_t n = ::recv(connection.fd, buf, sizeof(buf), 0);
+	if(n < 0 && (errno == EAGAIN || errno == EWOULDBLOCK || errno == EINTR)) return;
+	if(n <= 0)
+	{
+		// The player has gone, but might still be listening
+		connection.closing = true;
+		return;
+	}
+	connection.input.append(buf, n);
+
+	// Feed each whole line to the session
+	std::size_t start = 0;
+	std::size_t end;
+	while(!connection.session->over() &&
+		(end = connection.input.find('\n', start)) != std::string::npos)
+	{
+		connection.session->feed(connection.input.substr(start, end - start));
+		start = end + 1;
+	}
+	connection.input.erase(0, start);
+
+	connection.screen.take(connection.output);
+	if(connection.session->over()) connection.closing = true;
+
+	// Don't let someone fill up the server with a line that never ends,
+	// or output they never read
+	if(connection.input.size() > maxOutput || connection.output.size() > maxOutput)
+	{
+		connection.output.clear();
+		connection.closing = true;
+	}
+
+	return;
+}
+
+void Server::send(Connection& connection)
+{
+	while(!connection.output.empty())
+	{
+		// MSG_NOSIGNAL stops a player who has disconnected from killing
+		// the whole server with SIGPIPE
+		ssize_t n = ::send(connection.fd, connection.output.data(),
+			connection.output.size(), MSG_NOSIGNAL);
+		if(n < 0 && errno == EINTR) continue;
+		if(n < 0 && (errno == EAGAIN || errno == EWOULDBLOCK)) return;
+		if(n <= 0)
+		{
+			connection.output.clear();
+			connection.closing = true;
+			return;
+		}
+		connection.output.erase(0, n);
+	}
+
+	return;
+}
+
+void Server::work()
+{
+	std::vector<std::unique_ptr<Connection>> connections;
+	std::vector<pollfd> fds;
+	while(true)
+	{
+		// Watch for new connections, input from every player still
+		// playing, and room to send to the players who have output waiting
+		fds.clear();
+		pollfd listening = { this->listenFd, POLLIN, 0 };
+		fds.push_back(listening);
+		for(auto& connection : connections)
+		{
+			short events = connection->closing ? 0 : POLLIN;
+			if(!connection->output.empty()) events |= POLLOUT;
+			pollfd p = { connection->fd, events, 0 };
+			fds.push_back(p);
+		}
+		if(::poll(fds.data(), fds.size(), -1) < 0)
+		{
+			if(errno == EINTR) continue;
+			return;
+		}
+
+		for(unsigned int i = 0; i < connections.size(); ++i)
+		{
+			Connection& connection = *connections[i];
+			short events = fds[i+1].revents;
+			if(!connection.closing && (events & (POLLIN | POLLHUP | POLLERR))) this->receive(connection);
+			this->send(connection);
+		}
+		if(fds[0].revents & POLLERR) return;
+		if(fds[0].revents & POLLIN) this->accept(connections);
+
+		// Close the connections that are finished with
+		auto finished = std::partition(connections.begin(), connections.end(),
+			[](const std::unique_ptr<Connection>& connection)
+			{
+				return !connection->closing || !connection->output.empty();
+			});
+		for(auto it = finished; it != connections.end(); ++it)
+		{
+			::close((*it)->fd);
+			--this->numSessions;
+		}
+		connections.erase(finished, connections.end());
+	}
+}
+
+void Server::run()
+{
+	std::vector<std::thread> workers;
+	for(unsigned int i = 1; i < this->numWorkers; ++i)
+	{
+		workers.push_back(std::thread(&Server::work, this));
+	}
+	this->work();
+	for(auto& worker : workers) worker.join();
+
+	return;
+}
+
+Server::Server(SessionContext* context, unsigned int numWorkers, unsigned int maxSessions)
+{
+	this->context = context;
+	this->listenFd = -1;
+	if(numWorkers == 0) numWorkers = std::thread::hardware_concurrency();
+	if(numWorkers == 0) numWorkers = 1;
+	this->numWorkers = numWorkers;
+	this->numSessions = 0;
+	this->maxSessions = maxSessions;
+}
+
+Server::~Server()
+{
+	if(this->listenFd >= 0) ::close(this->listenFd);
+}
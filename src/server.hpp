@@ -0,0 +1,93 @@
+#ifndef SERVER_HPP
+#define SERVER_HPP
+
+#include <string>
+#include <vector>
+#include <memory>
+#include <atomic>
+
+#include "renderer.hpp"
+
+class Session;
+class SessionContext;
+
+// Lets many players connect to one game process over sockets, so the
+// content only has to be loaded once however many are playing.
+//
+// Sessions never wait for input, so there's no need for a thread per
+// player. Instead a small, fixed number of worker threads each run an
+// event loop, watching all of their connections at once with poll. When
+// a line arrives it's fed to that connection's session, and whatever the
+// session writes is sent back as the socket has room for it. Each worker
+// also accepts new connections, up to a limit on the number of players
+class Server
+{
+	private:
+
+	// A player's connection and the session they're playing
+	class Connection
+	{
+		public:
+
+		int fd;
+
+		// Where the session writes its output
+		Renderer screen;
+
+		// Input that doesn't make up a whole line yet, and output that
+		// hasn't been sent yet
+		std::string input;
+		std::string output;
+
+		// Set once the connection should be closed, which happens once the
+		// output has been sent
+		bool closing;
+
+		std::unique_ptr<Session> session;
+
+		Connection(int fd, SessionContext* context);
+	};
+
+	SessionContext* context;
+
+	// Socket new connections arrive on
+	int listenFd;
+
+	unsigned int numWorkers;
+
+	// Number of players connected, and how many are allowed
+	std::atomic<unsigned int> numSessions;
+	unsigned int maxSessions;
+
+	// Accept a waiting connection, if there is one and there's room
+	void accept(std::vector<std::unique_ptr<Connection>>& connections);
+
+	// Read what the player has sent and feed any whole lines to their
+	// session
+	void receive(Connection& connection);
+
+	// Send as much of the output as the socket will take
+	void send(Connection& connection);
+
+	// Body of each worker thread
+	void work();
+
+	public:
+
+	// Start listening on the address. An address containing a / is the
+	// path of a Unix domain socket, anything else is a TCP port on
+	// localhost. Returns false if the socket couldn't be opened
+	bool listen(const std::string& address);
+
+	// Run the workers. Only returns if the listening socket fails
+	void run();
+
+	// Constructor. Connections are spread over numWorkers threads, or one
+	// per core if 0, and up to maxSessions players can be connected at once
+	Server(SessionContext* context, unsigned int numWorkers, unsigned int maxSessions);
+
+	// Destructor
+	~Server();
+};
+
+#endif /* SERVER_HPP */
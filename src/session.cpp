@@ -0,0 +1,787 @@
+#include <algorithm>
+#include <cctype>
+#include <iostream>
+#include <sstream>
+#include <cstdlib>
+#include <string>
+#include <vector>
+#include <memory>
+#include <mutex>
+#include <random>
+#include <unordered_map>
+#include <unordered_set>
+
+#include "session.hpp"
+#include "item.hpp"
+#include "weapon.hpp"
+#include "armor.hpp"
+#include "inventory.hpp"
+#include "creature.hpp"
+#include "horde.hpp"
+#include "player.hpp"
+#include "dialogue.hpp"
+#include "area.hpp"
+#include "door.hpp"
+#include "battle.hpp"
+#include "entity_manager.hpp"
+#include "save_data.hpp"
+#include "save_writer.hpp"
+#include "journal.hpp"
+#include "world_graph.hpp"
+#include "world_overlay.hpp"
+#include "event_bus.hpp"
+#include "world_sim.hpp"
+#include "respawn_scheduler.hpp"
+#include "loot_table.hpp"
+#include "trace.hpp"
+#include "alloc_stats.hpp"
+
+// Longest name a player can have
+static const unsigned int maxNameLength = 32;
+
+// Names are used to name the save files, so only letters, numbers, _ and
+// - are allowed. Anything else, such as "../", could reach files outside
+// the working directory
+static bool validName(const std::string& name)
+{
+	if(name.empty() || name.size() > maxNameLength) return false;
+	for(char c : name)
+	{
+		if(!std::isalnum((unsigned char)c) && c != '_' && c != '-') return false;
+	}
+
+	return true;
+}
+
+bool SessionContext::join(const std::string& name)
+{
+	std::lock_guard<std::mutex> lock(this->mutex);
+
+	return this->playing.insert(name).second;
+}
+
+void SessionContext::leave(const std::string& name)
+{
+	std::lock_guard<std::mutex> lock(this->mutex);
+	this->playing.erase(name);
+
+	return;
+}
+
+SessionContext::SessionContext(EntityManager* mgr, WorldGraph* graph, SaveWriter* writer,
+	SaveStore* store, SaveFormat format)
+{
+	this->mgr = mgr;
+	this->graph = graph;
+	this->sim = nullptr;
+	this->single = false;
+	this->events = nullptr;
+	this->writer = writer;
+	this->store = store;
+	this->format = format;
+}
+
+Session::Session(SessionContext* context, std::ostream& out) :
+	context(context), out(out), world(context->mgr)
+{
+	this->joined = false;
+	this->numItems = 0;
+	this->battleXp = 0;
+	this->turns = 0;
+
+	// Ask for a name and class
+	// Name does not use a dialogue since dialogues only request options,
+	// not string input. Could be generalised into its own TextInput
+	// class, but not really necessary
+	this->state = SessionState::NAME;
+	this->out << "What's your name?\n";
+}
+
+Session::~Session()
+{
+	if(this->joined) this->context->leave(this->player.name);
+}
+
+bool Session::over()
+{
+	return this->state == SessionState::OVER;
+}
+
+unsigned int Session::numTurns()
+{
+	return this->turns;
+}
+
+SessionState Session::getState()
+{
+	return this->state;
+}
+
+Player& Session::getPlayer()
+{
+	return this->player;
+}
+
+WorldOverlay& Session::getWorld()
+{
+	return this->world;
+}
+
+void Session::feed(const std::string& line)
+{
+	TRACE_SCOPE("Session::feed");
+
+	std::istringstream words(line);
+	std::string word;
+	while(!this->over() && words >> word)
+	{
+		this->input(word);
+	}
+
+	return;
+}
+
+void Session::ask(SessionState state, const Dialogue& dialogue)
+{
+	ALLOC_SCOPE(AllocTag::DIALOGUE);
+
+	this->state = state;
+	this->dialogue = dialogue;
+	this->dialogue.show(this->out);
+
+	return;
+}
+
+void Session::input(const std::string& word)
+{
+	if(this->state == SessionState::NAME)
+	{
+		this->chooseName(word);
+		return;
+	}
+
+	// Everything else is a number, and anything that isn't is ignored
+	// until the player enters something that makes sense
+	std::istringstream ss(word);
+	int choice;
+	if(!(ss >> choice)) return;
+
+	switch(this->state)
+	{
+		case SessionState::EQUIP_ARMOR:
+		case SessionState::EQUIP_WEAPON:
+			this->chooseItem(choice);
+			return;
+		default:
+			break;
+	}
+
+	if(!this->dialogue.valid(choice)) return;
+
+	switch(this->state)
+	{
+		// New characters choose a class
+		case SessionState::CLASS:
+			switch(choice)
+			{
+				// Fighter class favours strength
+				case 1:
+					this->player = Player(this->player.name, 15, 5, 4, 1.0/64.0, 0, 1, "Fighter");
+					break;
+
+				// Rogue class favours agility
+				case 2:
+					this->player = Player(this->player.name, 15, 4, 5, 1.0/64.0, 0, 1, "Rogue");
+					break;
+
+				// Default case that should never happen, but it's good to be safe
+				default:
+					this->player = Player(this->player.name, 15, 4, 4, 1.0/64.0, 0, 1, "Adventurer");
+					break;
+			}
+			this->begin();
+			break;
+		case SessionState::AREA:
+			this->chooseInArea(choice);
+			break;
+		case SessionState::MENU:
+			this->chooseInMenu(choice);
+			break;
+		case SessionState::EQUIPMENT:
+			this->chooseEquipment(choice);
+			break;
+		case SessionState::TRAVEL:
+			this->chooseDestination(choice);
+			break;
+		case SessionState::BATTLE:
+			this->battle->answer(choice);
+			this->continueBattle();
+			break;
+		default:
+			break;
+	}
+
+	return;
+}
+
+// Create a new character or load an existing one
+void Session::chooseName(const std::string& name)
+{
+	if(!validName(name))
+	{
+		this->out << "Names can only have letters, numbers, _ and -, and be up to "
+			<< maxNameLength << " long.\nWhat's your name?\n";
+		return;
+	}
+
+	// Only one session can play as each player at a time, otherwise they
+	// would overwrite each other's saves
+	if(!this->context->join(name))
+	{
+		this->out << name << " is already playing.\n";
+		this->state = SessionState::OVER;
+		return;
+	}
+	this->joined = true;
+	this->player.name = name;
+
+	// The last session to play as them may have only just ended, with its
+	// final save still being written, so wait for it to finish before
+	// touching their files. Then make sure the save isn't left half
+	// written by a crash
+	this->context->writer->flush(name);
+	SaveWriter::recover(name);
+
+	// Load the player if they have a save, in either format, then
+	// bring them up to date with anything recorded in the journal
+	SaveStatus status = this->saveData.read(name, this->context->store);
+	if(status == SaveStatus::UNREADABLE)
+	{
+		// Starting again would overwrite the save, so leave it for
+		// someone to restore or repair
+		this->out << "The save for " << name << " can't be read, so they can't be played.\n";
+		this->state = SessionState::OVER;
+	}
+	else if(status == SaveStatus::LOADED)
+	{
+		this->player = Player(this->saveData, this->world);
+		Journal::replay(this->player, this->saveData, this->world);
+		this->begin();
+	}
+	else
+	{
+		static const Dialogue classes("Choose your class", {"Fighter", "Rogue"});
+		this->ask(SessionState::CLASS, classes);
+	}
+
+	return;
+}
+
+void Session::begin()
+{
+	// Set the current area of new players to be the first area in the
+	// atlas, placing the player there upon game start
+	if(this->player.currentArea == "") this->player.currentArea = "area_01";
+
+	// Actions are recorded in the journal as they happen, and folded
+	// into a full save every so often. Take a full save straight away
+	// so that there's always a save to replay the journal on top of
+	this->journal.reset(new Journal(this->player.name, this->saveData, this->context->writer));
+	this->journal->compact(this->player, this->world, *this->context->writer, this->context->format);
+
+	// Creatures come back to some areas a while after they're killed.
+	// Pick up any areas that were still waiting when the game was saved
+	this->respawns.build(this->world);
+
+	// The world sim moves creatures in this player's world from now on
+	if(this->context->sim != nullptr) this->context->sim->reset(this->world);
+
+	this->beginTurn();
+
+	return;
+}
+
+void Session::beginTurn()
+{
+#ifdef RPG_ALLOC_STATS
+	// Show what the last turn allocated, then start counting this one.
+	// Other sessions' turns would be counted too if there were any
+	if(this->context->single)
+	{
+		std::cerr << "Allocations on turn " << this->turns << ":\n";
+		AllocStats::report(std::cerr);
+		AllocStats::resetTurn();
+	}
+#endif
+
+	++this->turns;
+
+	// Everything the last turn recorded goes to disk together, synced on
+	// the writer's thread so the turn doesn't wait for it
+	this->journal->sync();
+
+	// Mark the current player as visited
+	this->player.visitedAreas.insert(this->player.currentArea);
+
+	// Bring back the creatures in any areas that are due, and let the rest
+	// of the world move, including any creatures that just came back
+	if(this->context->sim != nullptr)
+	{
+		this->respawned.clear();
+		this->respawns.update(this->player.moves, &this->respawned);
+		for(auto area : this->respawned) this->context->sim->wake(area->id);
+		this->context->sim->tick(this->world, this->player.currentArea);
+	}
+	else
+	{
+		this->respawns.update(this->player.moves);
+	}
+
+	// Pointer to to the current area for convenience. It may be shared,
+	// so it has to be swapped for the player's own copy before changing it.
+	// The sim may have just made the player's copy, so it's looked up after
+	Area* areaPtr = this->player.getAreaPtr(this->world);
+
+	// Autosave the game once enough has happened since the last save
+	if(this->journal->size() >= Journal::compactionInterval)
+	{
+		this->journal->compact(this->player, this->world, *this->context->writer, this->context->format);
+	}
+
+	// If the area has any creatures in it, start a battle with them
+	if(areaPtr->hasCreatures())
+	{
+		this->startBattle();
+		return;
+	}
+
+	// Add the movement and search options to the dialogue. They're
+	// written straight out when it's shown, rather than built up first
+	ALLOC_SCOPE(AllocTag::DIALOGUE);
+	Dialogue roomOptions = areaPtr->dialogue;
+	roomOptions.setExtraChoices(areaPtr->doors.size() + 2, [areaPtr](std::ostream& out, unsigned int n)
+	{
+		if(n < areaPtr->doors.size()) out << "Go through the " << areaPtr->doors[n]->description;
+		else if(n == areaPtr->doors.size()) out << "Search";
+		else out << "Fast travel";
+	});
+
+	// Activate the current area's dialogue
+	this->ask(SessionState::AREA, roomOptions);
+
+	return;
+}
+
+void Session::chooseInArea(int result)
+{
+	Area* areaPtr = this->player.getAreaPtr(this->world);
+	Dialogue& roomOptions = this->dialogue;
+
+	if(result == 0)
+	{
+		// Output the menu
+		static const Dialogue menu("Menu\n====", {"Items", "Equipment", "Character"});
+		this->ask(SessionState::MENU, menu);
+		return;
+	}
+	else if(result <= int(areaPtr->dialogue.size()))
+	{
+		// Add more events here
+	}
+	else if(result < int(roomOptions.size())-1)
+	{
+		Door* door = areaPtr->doors.at(result-areaPtr->dialogue.size()-1);
+		int flag = this->player.traverse(door, this->world);
+		if(flag != 0)
+		{
+			++this->player.moves;
+			this->journal->record(JournalAction::TRAVERSE, door->id);
+		}
+
+		switch(flag)
+		{
+			default:
+			case 0:
+				this->out << "The " << door->description << " is locked.\n";
+				break;
+			case 1:
+				this->out << "You unlock the " << door->description << " and go through it.\n";
+				break;
+			case 2:
+				this->out << "You go through the " << door->description << ".\n";
+				break;
+		}
+	}
+	else if(result == int(roomOptions.size())-1)
+	{
+		areaPtr = this->world.editArea(this->player.currentArea);
+		this->out << "You find:\n";
+		areaPtr->items.print(false, this->out);
+		if(this->context->events) this->publishFinds(areaPtr->items);
+		this->player.inventory.merge(&(areaPtr->items));
+		areaPtr->items.clear();
+		this->journal->record(JournalAction::SEARCH, areaPtr->id);
+	}
+	else
+	{
+		this->startTravel();
+		return;
+	}
+
+	this->beginTurn();
+
+	return;
+}
+
+void Session::chooseInMenu(int result)
+{
+	Player& player = this->player;
+
+	switch(result)
+	{
+		// Print the items that the player owns
+		case 1:
+			this->out << "Items\n=====\n";
+			player.inventory.print(false, this->out);
+			this->out << "----------------\n";
+			break;
+		// Print the equipment that the player is wearing (if they are
+		// wearing anything) and then ask if they want to equip a weapon
+		// or some armor
+		case 2:
+			this->out << "Equipment\n=========\n";
+			this->out << "Armor: "
+				<< (player.equippedArmor != nullptr ?
+					player.equippedArmor->name : "Nothing")
+				<< "\n";
+			this->out << "Weapon: "
+				<< (player.equippedWeapon != nullptr ?
+					player.equippedWeapon->name : "Nothing")
+				<< "\n";
+
+			static const Dialogue equipment("", {"Equip Armor", "Equip Weapon", "Close"});
+			this->ask(SessionState::EQUIPMENT, equipment);
+			return;
+		// Output the character information, including name, class (if
+		// they have one), stats, level, and experience
+		case 3:
+			this->out << "Character\n=========\n";
+			this->out << player.name;
+			if(player.className != "") this->out << " the " << player.className;
+			this->out << "\n";
+
+			this->out << "Health:   " << player.hp << " / " << player.maxHp << "\n";
+			this->out << "Strength: " << player.strength << "\n";
+			this->out << "Agility:  " << player.agility << "\n";
+			this->out << "Level:    " << player.level << " (" << player.xp;
+			this->out <<  " / " << player.xpToLevel(player.level+1) << ")\n";
+			this->out << "----------------\n";
+			break;
+		default:
+			break;
+	}
+
+	this->beginTurn();
+
+	return;
+}
+
+void Session::chooseEquipment(int result)
+{
+	// Equipping armor
+	if(result == 1)
+	{
+		// Cannot equip armor if they do not have any
+		// Print a list of the armor and retrieve the amount
+		// of armor in one go
+		this->numItems = this->player.inventory.print<Armor>(true, this->out);
+		if(this->numItems > 0)
+		{
+			// Choose a piece of armor to equip
+			this->state = SessionState::EQUIP_ARMOR;
+			this->out << "Equip which item?\n";
+			return;
+		}
+	}
+	// Equip a weapon, using the same algorithms as for armor
+	else if(result == 2)
+	{
+		this->numItems = this->player.inventory.print<Weapon>(true, this->out);
+		if(this->numItems > 0)
+		{
+			this->state = SessionState::EQUIP_WEAPON;
+			this->out << "Equip which item?\n";
+			return;
+		}
+	}
+	else
+	{
+		this->out << "----------------\n";
+	}
+
+	this->beginTurn();
+
+	return;
+}
+
+void Session::chooseItem(int userInput)
+{
+	// 0 asks again
+	if(userInput == 0)
+	{
+		this->out << "Equip which item?\n";
+		return;
+	}
+
+	// Equipment is numbered but is stored in a list,
+	// so the number must be converted into a list element
+	if(userInput >= 1 && userInput <= this->numItems)
+	{
+		if(this->state == SessionState::EQUIP_ARMOR)
+		{
+			this->player.equipArmor(this->player.inventory.get<Armor>(userInput-1));
+			this->journal->record(JournalAction::EQUIP_ARMOR, this->player.equippedArmor->id);
+		}
+		else
+		{
+			this->player.equipWeapon(this->player.inventory.get<Weapon>(userInput-1));
+			this->journal->record(JournalAction::EQUIP_WEAPON, this->player.equippedWeapon->id);
+		}
+	}
+	this->out << "----------------\n";
+
+	this->beginTurn();
+
+	return;
+}
+
+void Session::publishFinds(Inventory& items)
+{
+	// Items, weapons and armor each have their own prefix
+	Item* item;
+	for(unsigned int i = 0; (item = items.get<Item>(i)) != nullptr; ++i)
+	{
+		this->context->events->publish(GameEvent(GameEventType::FIND, this->player.name, item->id, items.count(item)));
+	}
+	for(unsigned int i = 0; (item = items.get<Weapon>(i)) != nullptr; ++i)
+	{
+		this->context->events->publish(GameEvent(GameEventType::FIND, this->player.name, item->id, items.count(item)));
+	}
+	for(unsigned int i = 0; (item = items.get<Armor>(i)) != nullptr; ++i)
+	{
+		this->context->events->publish(GameEvent(GameEventType::FIND, this->player.name, item->id, items.count(item)));
+	}
+
+	return;
+}
+
+void Session::startTravel()
+{
+	WorldGraph& worldGraph = *this->context->graph;
+	int from = worldGraph.node(this->player.currentArea);
+	if(from < 0)
+	{
+		this->beginTurn();
+		return;
+	}
+
+	// List the other areas the player has been to, in the same order
+	// every time
+	this->destinations.clear();
+	for(auto& id : this->player.visitedAreas)
+	{
+		int node = worldGraph.node(id);
+		if(node >= 0 && node != from) this->destinations.push_back(node);
+	}
+	if(this->destinations.empty())
+	{
+		this->out << "You haven't been anywhere else yet.\n";
+		this->beginTurn();
+		return;
+	}
+	std::sort(this->destinations.begin(), this->destinations.end());
+
+	// Destinations are described by their areas as the dialogue is shown
+	static const Dialogue travelPrompt("Travel where?", {});
+	Dialogue travelOptions = travelPrompt;
+	travelOptions.setExtraChoices(this->destinations.size(), [this](std::ostream& out, unsigned int n)
+	{
+		WorldGraph& worldGraph = *this->context->graph;
+		out << this->world.getArea(worldGraph.area(this->destinations[n])->id)->dialogue.getDescription();
+	});
+	this->ask(SessionState::TRAVEL, travelOptions);
+
+	return;
+}
+
+void Session::chooseDestination(int result)
+{
+	WorldGraph& worldGraph = *this->context->graph;
+	Player& player = this->player;
+
+	std::vector<Door*> path;
+	if(result <= 0)
+	{
+		// Staying put
+	}
+	else if(!worldGraph.findPath(worldGraph.node(player.currentArea), this->destinations[result-1],
+		&player.inventory, path, &player.visitedAreas, &this->world))
+	{
+		this->out << "You can't find a way there.\n";
+	}
+	else
+	{
+		// Go through each door in turn, as though the player had chosen them.
+		// Creatures might have appeared since the player was last there, so
+		// stop if there's anything to fight
+		for(auto door : path)
+		{
+			player.traverse(door, this->world);
+			++player.moves;
+			player.visitedAreas.insert(player.currentArea);
+			this->journal->record(JournalAction::TRAVERSE, door->id);
+			if(player.getAreaPtr(this->world)->hasCreatures()) break;
+		}
+		this->out << "You travel to "
+			<< player.getAreaPtr(this->world)->dialogue.getDescription() << "\n";
+	}
+
+	this->beginTurn();
+
+	return;
+}
+
+void Session::startBattle()
+{
+	ALLOC_SCOPE(AllocTag::BATTLE);
+
+	// Hordes lose members during the battle, and the area is
+	// cleared afterwards
+	Area* areaPtr = this->world.editArea(this->player.currentArea);
+
+	// Turn the creature instances into complete creatures for the
+	// battle, and create a vector of pointers to them
+	this->fighters.clear();
+	for(auto& instance : areaPtr->creatures)
+	{
+		this->fighters.push_back(instance.materialize());
+	}
+	std::vector<Creature*> combatants;
+	std::vector<std::string> names;
+	for(auto& fighter : this->fighters)
+	{
+		combatants.push_back(&fighter);
+		names.push_back(fighter.name);
+	}
+	// Hordes fight as a group, so they're passed to the battle
+	// separately. The experience for them has to be worked out now,
+	// since their members are taken out of them during the battle
+	std::vector<Horde*> hordes;
+	unsigned int hordeXp = 0;
+	for(auto& horde : areaPtr->hordes)
+	{
+		if(horde.count == 0) continue;
+		hordes.push_back(&horde);
+		names.push_back(horde.name());
+		hordeXp += horde.count * horde.base->xp;
+	}
+	// Or use std::accumulate, but that requires an additional header
+	this->battleXp = hordeXp;
+	for(auto& creature : areaPtr->creatures) this->battleXp += creature.base->xp;
+
+	// Roll for what the creatures drop now as well, for the same
+	// reason. Hordes roll once for every member
+	std::mt19937 gen(std::rand());
+	this->drops.clear();
+	for(auto& creature : areaPtr->creatures)
+	{
+		if(creature.base->loot != nullptr) creature.base->loot->rollMany(1, gen, this->drops);
+	}
+	for(auto horde : hordes)
+	{
+		if(horde->base->loot != nullptr) horde->base->loot->rollMany(horde->count, gen, this->drops);
+	}
+	this->out << "You are attacked by ";
+	for(unsigned int i = 0; i < names.size(); ++i)
+	{
+		this->out << names[i] << (i == names.size()-1 ? "!\n" : ", ");
+	}
+	// Add the player to the combatant vector
+	combatants.push_back(&this->player);
+	// Run the battle
+	this->battle.reset(new Battle(combatants, hordes, this->out, this->context->events));
+	this->continueBattle();
+
+	return;
+}
+
+void Session::continueBattle()
+{
+	Dialogue* question = this->battle->question();
+	if(question != nullptr)
+	{
+		this->ask(SessionState::BATTLE, *question);
+		return;
+	}
+
+	this->finishBattle();
+
+	return;
+}
+
+void Session::finishBattle()
+{
+	ALLOC_SCOPE(AllocTag::BATTLE);
+
+	Player& player = this->player;
+	Area* areaPtr = this->world.editArea(player.currentArea);
+	this->battle.reset();
+	this->fighters.clear();
+
+	// If the player is still alive, grant them some experience, assuming
+	// that every creature was killed
+	if(player.hp > 0)
+	{
+		unsigned int xp = this->battleXp;
+		this->out << "You gained " << xp << " experience!\n";
+		if(this->context->events)
+		{
+			this->context->events->publish(GameEvent(GameEventType::VICTORY, player.name, areaPtr->id, xp));
+		}
+		player.xp += xp;
+		// Grow as many levels as the experience allows
+		while(player.levelUp(this->out, this->context->events)) {}
+		// Remove the creatures from the area, until they respawn
+		areaPtr->clearCreatures(player.moves);
+		this->respawns.schedule(areaPtr);
+		this->journal->record(JournalAction::BATTLE, areaPtr->id, player.hp);
+		this->journal->record(JournalAction::XP, "", xp);
+		// Leave the loot on the floor for the player to pick up
+		if(!this->drops.empty())
+		{
+			Inventory dropped;
+			for(auto& drop : this->drops)
+			{
+				dropped.add(drop.first, int(drop.second));
+				this->journal->record(JournalAction::DROP, drop.first->id, int(drop.second));
+			}
+			this->out << "They dropped:\n";
+			dropped.print(false, this->out);
+			areaPtr->items.merge(&dropped);
+		}
+		// Carry on with the game as usual
+		this->beginTurn();
+	}
+	// Otherwise player is dead, so end the session
+	else
+	{
+		this->out << "\t----YOU DIED----\n    Game Over\n";
+		if(this->context->events)
+		{
+			this->context->events->publish(GameEvent(GameEventType::DEATH, player.name, areaPtr->id));
+		}
+		this->state = SessionState::OVER;
+	}
+
+	return;
+}
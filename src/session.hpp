@@ -0,0 +1,205 @@
+#ifndef SESSION_HPP
+#define SESSION_HPP
+
+#include <string>
+#include <vector>
+#include <memory>
+#include <iostream>
+#include <mutex>
+#include <unordered_map>
+#include <unordered_set>
+
+#include "save_data.hpp"
+#include "world_overlay.hpp"
+#include "respawn_scheduler.hpp"
+#include "player.hpp"
+#include "journal.hpp"
+#include "dialogue.hpp"
+#include "battle.hpp"
+
+class EntityManager;
+class WorldGraph;
+class WorldSim;
+class SaveStore;
+class SaveWriter;
+class EventBus;
+class Item;
+
+// Everything that's loaded once and shared between every session in the
+// process. None of it is changed by the sessions, apart from the set of
+// players currently playing, so any number of sessions can use it at once
+class SessionContext
+{
+	private:
+
+	// Names of the players currently in a session
+	std::unordered_set<std::string> playing;
+	std::mutex mutex;
+
+	public:
+
+	EntityManager* mgr;
+	WorldGraph* graph;
+
+	// Moves creatures around the player's world each turn. It only keeps
+	// track of one player's world, so is only used when there's a single
+	// session
+	WorldSim* sim;
+
+	// True if only one session plays at a time, such as at the terminal
+	// or from a script, rather than many at once on the server or in a
+	// soak. Allocations are only counted per turn for a single session,
+	// since the counts are shared by the whole process
+	bool single;
+
+	// Where things that happen in the game are published, or nullptr if
+	// nothing is listening
+	EventBus* events;
+
+	// Where saves go, and in what format
+	SaveWriter* writer;
+	SaveStore* store;
+	SaveFormat format;
+
+	// Claim the name for a session, returning false if someone is already
+	// playing as them
+	bool join(const std::string& name);
+
+	// Give up the name when the session ends
+	void leave(const std::string& name);
+
+	// Constructor
+	SessionContext(EntityManager* mgr, WorldGraph* graph, SaveWriter* writer,
+		SaveStore* store, SaveFormat format);
+};
+
+// What the session is waiting for the player to enter
+enum class SessionState { NAME, CLASS, AREA, MENU, EQUIPMENT, EQUIP_ARMOR,
+	EQUIP_WEAPON, TRAVEL, BATTLE, OVER };
+
+// One player's game, from choosing a character until they die or leave.
+// A session never waits for input itself. Instead it's fed the player's
+// input whenever some arrives, does whatever the input asks for, asks its
+// next question and returns. Sessions are small and don't need a thread
+// each, so one thread can keep thousands of them going. Every session
+// sees the world through its own overlay, so none of them change anything
+// shared
+class Session
+{
+	private:
+
+	SessionContext* context;
+
+	// Where the game is shown
+	std::ostream& out;
+
+	// The world as this player sees it
+	WorldOverlay world;
+
+	SaveData saveData;
+	Player player;
+
+	// True once the player's name has been claimed
+	bool joined;
+
+	// Created once the player has been loaded or created
+	std::unique_ptr<Journal> journal;
+
+	RespawnScheduler respawns;
+
+	// Areas respawned this turn, kept so that it doesn't allocate each turn
+	std::vector<Area*> respawned;
+
+	SessionState state;
+
+	// Number of times round the game loop
+	unsigned int turns;
+
+	// The question being asked, which the player's answer is checked
+	// against
+	Dialogue dialogue;
+
+	// Areas offered by the fast travel menu
+	std::vector<unsigned int> destinations;
+
+	// Number of items offered to equip
+	int numItems;
+
+	// The battle being fought, and what it needs once it's over. The
+	// combatants point into fighters, so it isn't changed during the
+	// battle
+	std::unique_ptr<Battle> battle;
+	std::vector<Creature> fighters;
+	unsigned int battleXp;
+	std::unordered_map<Item*, unsigned long long> drops;
+
+	// Show the dialogue and wait for the player to answer it
+	void ask(SessionState state, const Dialogue& dialogue);
+
+	// Handle one word of input
+	void input(const std::string& word);
+
+	// Load the player's save, or ask them to choose a class if they're new
+	void chooseName(const std::string& name);
+
+	// Start playing once the player is ready
+	void begin();
+
+	// Go round the game loop once: let the world move on, then start a
+	// battle if there's anything to fight, otherwise ask the player what
+	// they want to do in the area they're in
+	void beginTurn();
+
+	// Act on the choice made in the area
+	void chooseInArea(int result);
+
+	// Character information menu, displays the items the player has, their
+	// current stats etc. Equipment changes are recorded in the journal
+	void chooseInMenu(int result);
+	void chooseEquipment(int result);
+	void chooseItem(int result);
+
+	// Publish an event for each of the items the player has found
+	void publishFinds(Inventory& items);
+
+	// Fast travel menu. Moves the player to an area they have already
+	// visited, going only through areas they have visited on the way
+	void startTravel();
+	void chooseDestination(int result);
+
+	// Fight whatever is in the current area
+	void startBattle();
+
+	// Ask the battle's next question, or finish the battle if it's over
+	void continueBattle();
+
+	// Reward the player if they won, or end the game if they didn't
+	void finishBattle();
+
+	public:
+
+	// Handle a line of input from the player. The line may hold several
+	// answers, separated by spaces, just like the terminal allows
+	void feed(const std::string& line);
+
+	// True once the game has finished and no more input is wanted
+	bool over();
+
+	// Number of turns the player has had so far
+	unsigned int numTurns();
+
+	// What the session is waiting for, and the player and the world as
+	// they are now, so that something other than a person can decide
+	// what to enter
+	SessionState getState();
+	Player& getPlayer();
+	WorldOverlay& getWorld();
+
+	// Constructor. Asks the player for their name
+	Session(SessionContext* context, std::ostream& out);
+
+	// Destructor. Frees up the player's name for another session
+	~Session();
+};
+
+#endif /* SESSION_HPP */
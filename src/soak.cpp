@@ -0,0 +1,215 @@
+#include <string>
+#include <vector>
+#include <memory>
+#include <iostream>
+#include <fstream>
+#include <iomanip>
+#include <algorithm>
+#include <thread>
+#include <mutex>
+#include <chrono>
+#include <dirent.h>
+#include <sys/stat.h>
+#include <unistd.h>
+
+#include "soak.hpp"
+#include "bot.hpp"
+#include "session.hpp"
+#include "player.hpp"
+#include "renderer.hpp"
+
+const std::string Soak::prefix = "soak";
+
+// Memory the process is using, in bytes
+static long long residentBytes()
+{
+	std::ifstream statm("/proc/self/statm");
+	long long size = 0;
+	long long resident = 0;
+	statm >> size >> resident;
+
+	return resident * sysconf(_SC_PAGESIZE);
+}
+
+// Total size of the bots' saves and journals, and of the save store if
+// there is one, along with the number of files
+static long long saveBytes(unsigned int& numFiles)
+{
+	long long bytes = 0;
+	numFiles = 0;
+	DIR* dir = opendir(".");
+	if(dir == nullptr) return 0;
+	while(dirent* entry = readdir(dir))
+	{
+		std::string name = entry->d_name;
+		if(name.compare(0, Soak::prefix.size(), Soak::prefix) != 0 && name != "saves.db") continue;
+		struct stat st;
+		if(stat(name.c_str(), &st) != 0) continue;
+		bytes += st.st_size;
+		++numFiles;
+	}
+	closedir(dir);
+
+	return bytes;
+}
+
+// Value below which the given fraction of the sorted latencies fall,
+// in microseconds
+static double percentile(const std::vector<long long>& sorted, double fraction)
+{
+	if(sorted.empty()) return 0;
+
+	return sorted[(unsigned long long)(fraction * (sorted.size()-1))] / 1000.0;
+}
+
+static double megabytes(long long bytes)
+{
+	return bytes / (1024.0 * 1024.0);
+}
+
+Soak::Worker::Worker()
+{
+	this->actions = 0;
+	this->turns = 0;
+	this->sessions = 0;
+	this->deaths = 0;
+	this->bestLevel = 0;
+}
+
+void Soak::work(Worker* worker, unsigned int index)
+{
+	// The game's output is thrown away
+	Renderer screen;
+
+	unsigned int player = 0;
+	Bot bot(prefix + std::to_string(index) + "_" + std::to_string(player), index);
+	while(!this->stopping.load())
+	{
+		Session session(this->context, screen.out);
+		// Give up on the session if the bot is getting nowhere, such as
+		// when it keeps entering something the game won't accept
+		unsigned long long actions = 0;
+		unsigned long long maxActions = 20ULL * this->turnsPerSession;
+		while(!session.over() && session.numTurns() < this->turnsPerSession
+			&& actions < maxActions && !this->stopping.load())
+		{
+			std::string line = bot.answer(session);
+			unsigned int turns = session.numTurns();
+			auto start = std::chrono::steady_clock::now();
+			session.feed(line);
+			auto end = std::chrono::steady_clock::now();
+			++actions;
+
+			std::lock_guard<std::mutex> lock(worker->mutex);
+			worker->latencies.push_back(std::chrono::duration_cast<std::chrono::nanoseconds>(end - start).count());
+			++worker->actions;
+			worker->turns += session.numTurns() - turns;
+		}
+
+		std::lock_guard<std::mutex> lock(worker->mutex);
+		++worker->sessions;
+		worker->bestLevel = std::max(worker->bestLevel, session.getPlayer().level);
+		// A player who died is replaced, otherwise they carry on next time
+		if(session.over() && session.getPlayer().hp <= 0)
+		{
+			++worker->deaths;
+			bot.name = prefix + std::to_string(index) + "_" + std::to_string(++player);
+		}
+	}
+
+	return;
+}
+
+void Soak::run(unsigned int numBots, double seconds, double reportInterval, std::ostream& out)
+{
+	unsigned int numFiles = 0;
+	long long startMemory = residentBytes();
+	long long startSaves = saveBytes(numFiles);
+
+	this->stopping = false;
+	this->workers.clear();
+	for(unsigned int i = 0; i < numBots; ++i)
+	{
+		this->workers.push_back(std::unique_ptr<Worker>(new Worker));
+	}
+	for(unsigned int i = 0; i < numBots; ++i)
+	{
+		this->workers[i]->thread = std::thread(&Soak::work, this, this->workers[i].get(), i);
+	}
+
+	// Totals over the whole run
+	unsigned long long actions = 0;
+	unsigned long long turns = 0;
+	unsigned long long sessions = 0;
+	unsigned long long deaths = 0;
+	unsigned int bestLevel = 0;
+
+	auto start = std::chrono::steady_clock::now();
+	auto last = start;
+	double elapsed = 0;
+	while(elapsed < seconds)
+	{
+		std::this_thread::sleep_for(std::chrono::duration<double>(std::min(reportInterval, seconds - elapsed)));
+		auto now = std::chrono::steady_clock::now();
+		elapsed = std::chrono::duration<double>(now - start).count();
+		double interval = std::chrono::duration<double>(now - last).count();
+		last = now;
+
+		// Collect what's been played since the last report
+		std::vector<long long> latencies;
+		unsigned long long intervalActions = 0;
+		unsigned long long intervalTurns = 0;
+		for(auto& worker : this->workers)
+		{
+			std::lock_guard<std::mutex> lock(worker->mutex);
+			latencies.insert(latencies.end(), worker->latencies.begin(), worker->latencies.end());
+			worker->latencies.clear();
+			intervalActions += worker->actions;
+			intervalTurns += worker->turns;
+			sessions += worker->sessions;
+			deaths += worker->deaths;
+			bestLevel = std::max(bestLevel, worker->bestLevel);
+			worker->actions = 0;
+			worker->turns = 0;
+			worker->sessions = 0;
+			worker->deaths = 0;
+		}
+		actions += intervalActions;
+		turns += intervalTurns;
+		std::sort(latencies.begin(), latencies.end());
+
+		long long memory = residentBytes();
+		long long saves = saveBytes(numFiles);
+
+		out << std::fixed << std::setprecision(1)
+			<< "[" << elapsed << "s] "
+			<< intervalActions / interval << " actions/s, "
+			<< intervalTurns / interval << " turns/s, "
+			<< sessions << " sessions, " << deaths << " deaths, best level " << bestLevel << "\n"
+			<< "    latency us p50 " << percentile(latencies, 0.5)
+			<< " p90 " << percentile(latencies, 0.9)
+			<< " p99 " << percentile(latencies, 0.99)
+			<< " max " << percentile(latencies, 1.0) << "\n"
+			<< "    memory " << megabytes(memory) << "MB (" << std::showpos
+			<< megabytes(memory - startMemory) << "MB)" << std::noshowpos
+			<< ", saves " << megabytes(saves) << "MB in " << numFiles << " files ("
+			<< std::showpos << megabytes(saves - startSaves) << "MB)" << std::noshowpos << "\n";
+		out.flush();
+	}
+
+	this->stopping = true;
+	for(auto& worker : this->workers) worker->thread.join();
+
+	out << "Played " << actions << " actions and " << turns << " turns in "
+		<< elapsed << "s (" << actions / elapsed << " actions/s, "
+		<< turns / elapsed << " turns/s)\n";
+
+	return;
+}
+
+Soak::Soak(SessionContext* context, unsigned int turnsPerSession)
+{
+	this->context = context;
+	this->turnsPerSession = turnsPerSession;
+	this->stopping = false;
+}
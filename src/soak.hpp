@@ -0,0 +1,79 @@
+#ifndef SOAK_HPP
+#define SOAK_HPP
+
+#include <string>
+#include <vector>
+#include <memory>
+#include <iostream>
+#include <thread>
+#include <mutex>
+#include <atomic>
+
+class SessionContext;
+
+// Keeps bots playing the game on many threads at once for as long as
+// asked, to find leaks and slowdowns that only show up after hours of
+// play. Each thread runs one bot at a time. A bot plays a session until
+// its player dies or it has had a set number of turns, then starts
+// another. A player who survives is carried on in the next session, so
+// saves are loaded as well as written, whilst a player who dies is
+// replaced by a new one.
+//
+// Every so often a line is written saying how many actions and turns
+// were played and how long the actions took, along with how much memory
+// the process is using and how big the bots' saves are, and how both
+// have grown since the start
+class Soak
+{
+	private:
+
+	// A thread and what it's played since the last report
+	class Worker
+	{
+		public:
+
+		std::thread thread;
+
+		// Taken whilst an action is counted, and whilst the counts are
+		// collected for a report
+		std::mutex mutex;
+
+		// Time taken by each action, in nanoseconds
+		std::vector<long long> latencies;
+
+		unsigned long long actions;
+		unsigned long long turns;
+		unsigned long long sessions;
+		unsigned long long deaths;
+		unsigned int bestLevel;
+
+		Worker();
+	};
+
+	SessionContext* context;
+
+	std::vector<std::unique_ptr<Worker>> workers;
+
+	std::atomic<bool> stopping;
+
+	// Body of each worker thread
+	void work(Worker* worker, unsigned int index);
+
+	public:
+
+	// Saves of the bots' players are named with this, followed by the
+	// number of the worker and of the player
+	static const std::string prefix;
+
+	// Number of turns a player is played for in one session
+	unsigned int turnsPerSession;
+
+	// Play with numBots bots for the given number of seconds, reporting
+	// to out every reportInterval seconds
+	void run(unsigned int numBots, double seconds, double reportInterval, std::ostream& out);
+
+	// Constructor
+	Soak(SessionContext* context, unsigned int turnsPerSession = 500);
+};
+
+#endif /* SOAK_HPP */
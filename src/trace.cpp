@@ -0,0 +1,162 @@
+#include <string>
+#include <vector>
+#include <memory>
+#include <mutex>
+#include <atomic>
+#include <thread>
+#include <chrono>
+#include <fstream>
+#include <cstdlib>
+#include <signal.h>
+#include <pthread.h>
+
+#include "trace.hpp"
+#include "json_writer.hpp"
+
+// One timed block. The fields are atomic because the trace can be written
+// out whilst the thread is still recording; a record overwritten at that
+// moment might come out muddled, but never does any harm
+class TraceRecord
+{
+	public:
+
+	std::atomic<const char*> name;
+	std::atomic<long long> start;
+	std::atomic<long long> duration;
+};
+
+// Ring of records belonging to one thread
+class TraceBuffer
+{
+	public:
+
+	static const unsigned long long capacity = 1 << 15;
+
+	TraceRecord records[capacity];
+
+	// Number of records ever made by the thread
+	std::atomic<unsigned long long> count;
+
+	unsigned int thread;
+};
+
+// Every thread's ring, kept until the process exits so that records from
+// threads that have finished can still be written out
+static std::mutex buffersMutex;
+static std::vector<std::unique_ptr<TraceBuffer>> buffers;
+
+static std::string traceFilename = "trace.json";
+static std::chrono::steady_clock::time_point epoch = std::chrono::steady_clock::now();
+
+// Give the calling thread a ring of its own
+static TraceBuffer* threadBuffer()
+{
+	std::lock_guard<std::mutex> lock(buffersMutex);
+	std::unique_ptr<TraceBuffer> buffer(new TraceBuffer);
+	buffer->count = 0;
+	buffer->thread = buffers.size() + 1;
+	buffers.push_back(std::move(buffer));
+
+	return buffers.back().get();
+}
+
+static void dumpAtExit()
+{
+	Trace::dump();
+
+	return;
+}
+
+// Write the trace each time SIGUSR1 arrives
+static void watchSignal()
+{
+	sigset_t set;
+	sigemptyset(&set);
+	sigaddset(&set, SIGUSR1);
+	while(true)
+	{
+		int sig;
+		if(sigwait(&set, &sig) == 0) Trace::dump();
+	}
+}
+
+void Trace::start(const std::string& filename)
+{
+	traceFilename = filename;
+
+	// Stop SIGUSR1 killing the process. Threads started from now on
+	// inherit the mask, so only the watching thread ever receives it
+	sigset_t set;
+	sigemptyset(&set);
+	sigaddset(&set, SIGUSR1);
+	pthread_sigmask(SIG_BLOCK, &set, nullptr);
+	std::thread(watchSignal).detach();
+
+	std::atexit(dumpAtExit);
+
+	return;
+}
+
+void Trace::dump()
+{
+	std::lock_guard<std::mutex> lock(buffersMutex);
+
+	// Chrome's format: a complete ("X") event for each block, with times
+	// in microseconds
+	JsonWriter out;
+	out.beginObject();
+	out.key("traceEvents");
+	out.beginArray();
+	for(auto& buffer : buffers)
+	{
+		unsigned long long count = buffer->count.load(std::memory_order_acquire);
+		unsigned long long first = count > TraceBuffer::capacity ? count - TraceBuffer::capacity : 0;
+		for(unsigned long long i = first; i < count; ++i)
+		{
+			TraceRecord& record = buffer->records[i & (TraceBuffer::capacity - 1)];
+			out.beginObject();
+			out.key("name");
+			out.value(record.name.load(std::memory_order_relaxed));
+			out.key("ph");
+			out.value("X");
+			out.key("ts");
+			out.value(record.start.load(std::memory_order_relaxed) / 1000.0);
+			out.key("dur");
+			out.value(record.duration.load(std::memory_order_relaxed) / 1000.0);
+			out.key("pid");
+			out.value(1);
+			out.key("tid");
+			out.value(buffer->thread);
+			out.endObject();
+		}
+	}
+	out.endArray();
+	out.endObject();
+
+	std::ofstream file(traceFilename, std::ios::trunc);
+	file << out.buffer;
+
+	return;
+}
+
+void Trace::record(const char* name, long long start, long long duration)
+{
+	static thread_local TraceBuffer* buffer = threadBuffer();
+
+	// Only this thread writes to its ring, so there's no need to claim
+	// the record first
+	unsigned long long n = buffer->count.load(std::memory_order_relaxed);
+	TraceRecord& record = buffer->records[n & (TraceBuffer::capacity - 1)];
+	record.name.store(name, std::memory_order_relaxed);
+	record.start.store(start, std::memory_order_relaxed);
+	record.duration.store(duration, std::memory_order_relaxed);
+	buffer->count.store(n + 1, std::memory_order_release);
+
+	return;
+}
+
+long long Trace::now()
+{
+	return std::chrono::duration_cast<std::chrono::nanoseconds>(
+		std::chrono::steady_clock::now() - epoch).count();
+}
@@ -0,0 +1,67 @@
+#ifndef TRACE_HPP
+#define TRACE_HPP
+
+#include <string>
+
+// Records how long parts of the game take, so a slow save or battle turn
+// can be looked at afterwards. Put TRACE_SCOPE("name") at the start of a
+// block and the time until the end of the block is recorded under that
+// name. The name must be a string literal, since only the pointer is kept.
+//
+// Tracing is only compiled in when RPG_TRACE is defined, otherwise
+// TRACE_SCOPE does nothing at all. Each thread records into a ring of its
+// own, so recording never locks, and once a ring is full the oldest
+// records are overwritten. The rings are written out as a Chrome trace
+// (open it in chrome://tracing or ui.perfetto.dev) when the game exits, or
+// whenever the process is sent SIGUSR1
+#ifdef RPG_TRACE
+#define TRACE_CONCAT2(a, b) a##b
+#define TRACE_CONCAT(a, b) TRACE_CONCAT2(a, b)
+#define TRACE_SCOPE(name) TraceScope TRACE_CONCAT(traceScope, __LINE__)(name)
+#else
+#define TRACE_SCOPE(name)
+#endif
+
+class Trace
+{
+	public:
+
+	// Start watching for SIGUSR1 and write the trace to the file on exit.
+	// Must be called before any other threads are started, so that they
+	// leave the signal to the thread watching for it
+	static void start(const std::string& filename);
+
+	// Write out everything recorded so far
+	static void dump();
+
+	// Record that the named block ran from start for the given time, in
+	// nanoseconds since tracing started
+	static void record(const char* name, long long start, long long duration);
+
+	// Nanoseconds since tracing started
+	static long long now();
+};
+
+// Times the block it's declared in
+class TraceScope
+{
+	private:
+
+	const char* name;
+	long long start;
+
+	public:
+
+	TraceScope(const char* name)
+	{
+		this->name = name;
+		this->start = Trace::now();
+	}
+
+	~TraceScope()
+	{
+		Trace::record(this->name, this->start, Trace::now() - this->start);
+	}
+};
+
+#endif /* TRACE_HPP */
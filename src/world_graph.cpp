@@ -0,0 +1,247 @@
+#include <string>
+#include <vector>
+#include <queue>
+#include <functional>
+#include <utility>
+#include <algorithm>
+#include <unordered_map>
+#include <unordered_set>
+
+#include "world_graph.hpp"
+#include "area.hpp"
+#include "door.hpp"
+#include "inventory.hpp"
+#include "entity_manager.hpp"
+#include "world_overlay.hpp"
+
+const unsigned int WorldGraph::unreachable;
+
+// Breadth first search outwards from the start node, ignoring locks,
+// filling distances with the number of doors to every node
+static void breadthFirst(const std::vector<unsigned int>& edgeStart,
+	const std::vector<WorldGraph::Edge>& edges, unsigned int start,
+	std::vector<unsigned int>& distances)
+{
+	distances.assign(edgeStart.size() - 1, WorldGraph::unreachable);
+	std::queue<unsigned int> open;
+	distances[start] = 0;
+	open.push(start);
+	while(!open.empty())
+	{
+		unsigned int n = open.front();
+		open.pop();
+		for(unsigned int e = edgeStart[n]; e < edgeStart[n+1]; ++e)
+		{
+			unsigned int to = edges[e].to;
+			if(distances[to] != WorldGraph::unreachable) continue;
+			distances[to] = distances[n] + 1;
+			open.push(to);
+		}
+	}
+
+	return;
+}
+
+bool WorldGraph::passable(Door* door, Inventory* keys, WorldOverlay* world)
+{
+	int locked = world != nullptr ? world->locked(door) : door->locked;
+	if(locked <= 0) return true;
+	return keys != nullptr && door->key != nullptr && keys->count(door->key) > 0;
+}
+
+void WorldGraph::build(EntityManager* mgr, unsigned int numLandmarks)
+{
+	// Number the areas
+	this->areas = mgr->getEntities<Area>();
+	this->nodes.clear();
+	for(unsigned int n = 0; n < this->areas.size(); ++n)
+	{
+		this->nodes[this->areas[n]->id] = n;
+	}
+
+	// Each door in an area leads to whichever of its areas isn't this one.
+	// Doors that lead to areas which don't exist are left out
+	this->edgeStart.assign(1, 0);
+	this->edges.clear();
+	for(unsigned int n = 0; n < this->areas.size(); ++n)
+	{
+		Area* area = this->areas[n];
+		for(auto door : area->doors)
+		{
+			const std::string& other = door->areas.first == area->id ?
+				door->areas.second : door->areas.first;
+			int to = this->node(other);
+			if(to < 0) continue;
+			Edge edge;
+			edge.to = to;
+			edge.door = door;
+			this->edges.push_back(edge);
+		}
+		this->edgeStart.push_back(this->edges.size());
+	}
+
+	// Pick landmarks spread out around the world, each one being the area
+	// furthest from all the landmarks chosen so far
+	this->landmarkDistances.clear();
+	if(this->areas.empty()) return;
+	std::vector<unsigned int> nearest(this->areas.size(), unreachable);
+	unsigned int landmark = 0;
+	for(unsigned int i = 0; i < numLandmarks && i < this->areas.size(); ++i)
+	{
+		this->landmarkDistances.push_back(std::vector<unsigned int>());
+		std::vector<unsigned int>& distances = this->landmarkDistances.back();
+		breadthFirst(this->edgeStart, this->edges, landmark, distances);
+
+		// Unreachable areas count as the furthest of all, so that each
+		// separate part of the world gets a landmark
+		unsigned int furthest = 0;
+		for(unsigned int n = 0; n < this->areas.size(); ++n)
+		{
+			nearest[n] = std::min(nearest[n], distances[n]);
+			if(nearest[n] > nearest[furthest]) furthest = n;
+		}
+		if(nearest[furthest] == 0) break;
+		landmark = furthest;
+	}
+
+	return;
+}
+
+int WorldGraph::node(const std::string& areaId) const
+{
+	auto it = this->nodes.find(areaId);
+	if(it == this->nodes.end()) return -1;
+	return it->second;
+}
+
+Area* WorldGraph::area(unsigned int node) const
+{
+	return this->areas.at(node);
+}
+
+unsigned int WorldGraph::size() const
+{
+	return this->areas.size();
+}
+
+const WorldGraph::Edge* WorldGraph::edgesBegin(unsigned int node) const
+{
+	return this->edges.data() + this->edgeStart[node];
+}
+
+const WorldGraph::Edge* WorldGraph::edgesEnd(unsigned int node) const
+{
+	return this->edges.data() + this->edgeStart[node+1];
+}
+
+unsigned int WorldGraph::estimate(unsigned int from, unsigned int to) const
+{
+	// Going through a locked door never makes a route shorter, so the
+	// landmark distances still give a lower bound when doors are locked
+	unsigned int best = 0;
+	for(auto& distances : this->landmarkDistances)
+	{
+		unsigned int a = distances[from];
+		unsigned int b = distances[to];
+		// If only one of them can reach the landmark then they can't
+		// reach each other either, but the search will find that out
+		if(a == unreachable || b == unreachable) continue;
+		best = std::max(best, a > b ? a - b : b - a);
+	}
+
+	return best;
+}
+
+bool WorldGraph::findPath(unsigned int from, unsigned int to, Inventory* keys,
+	std::vector<Door*>& path, const std::unordered_set<std::string>* allowed,
+	WorldOverlay* world) const
+{
+	path.clear();
+	if(from == to) return true;
+
+	// Only the nodes the search reaches are stored, so a short route in a
+	// huge world stays cheap. Nothing in the graph is changed, so several
+	// searches can run at once
+	std::unordered_map<unsigned int, unsigned int> cost;
+	std::unordered_map<unsigned int, unsigned int> cameBy;
+	typedef std::pair<unsigned int, unsigned int> Open;
+	std::priority_queue<Open, std::vector<Open>, std::greater<Open>> open;
+
+	cost[from] = 0;
+	open.push(std::make_pair(this->estimate(from, to), from));
+	while(!open.empty())
+	{
+		unsigned int n = open.top().second;
+		unsigned int f = open.top().first;
+		open.pop();
+		unsigned int g = cost[n];
+		// Skip nodes that were queued again with a lower cost
+		if(f > g + this->estimate(n, to)) continue;
+		if(n == to) break;
+
+		for(unsigned int e = this->edgeStart[n]; e < this->edgeStart[n+1]; ++e)
+		{
+			const Edge& edge = this->edges[e];
+			if(!passable(edge.door, keys, world)) continue;
+			if(allowed != nullptr && edge.to != to &&
+				allowed->count(this->areas[edge.to]->id) == 0) continue;
+
+			auto it = cost.find(edge.to);
+			if(it != cost.end() && it->second <= g + 1) continue;
+			cost[edge.to] = g + 1;
+			cameBy[edge.to] = e;
+			open.push(std::make_pair(g + 1 + this->estimate(edge.to, to), edge.to));
+		}
+	}
+	if(cost.find(to) == cost.end()) return false;
+
+	// Walk back from the destination to get the doors in reverse
+	for(unsigned int n = to; n != from; )
+	{
+		unsigned int e = cameBy[n];
+		path.push_back(this->edges[e].door);
+		// The edge was found by looking through the edges of the node
+		// it leaves from, so find which node that was
+		n = std::upper_bound(this->edgeStart.begin(), this->edgeStart.end(), e) -
+			this->edgeStart.begin() - 1;
+	}
+	std::reverse(path.begin(), path.end());
+
+	return true;
+}
+
+void WorldGraph::distancesTo(unsigned int target, Inventory* keys, std::vector<unsigned int>& distances,
+	unsigned int maxDistance, WorldOverlay* world) const
+{
+	// Doors work the same in both directions, so searching outwards from
+	// the target gives the distance from everywhere else to it
+	distances.assign(this->areas.size(), unreachable);
+	std::vector<unsigned int> reached;
+	this->distancesTo(target, keys, distances, maxDistance, reached, world);
+
+	return;
+}
+
+void WorldGraph::distancesTo(unsigned int target, Inventory* keys, std::vector<unsigned int>& distances,
+	unsigned int maxDistance, std::vector<unsigned int>& reached, WorldOverlay* world) const
+{
+	// The nodes reached are in the order they were found, so they double
+	// as the queue of nodes still to search from
+	unsigned int next = reached.size();
+	distances[target] = 0;
+	reached.push_back(target);
+	while(next < reached.size())
+	{
+		unsigned int n = reached[next++];
+		if(distances[n] >= maxDistance) continue;
+		for(unsigned int e = this->edgeStart[n]; e < this->edgeStart[n+1]; ++e)
+		{
+			const Edge& edge = this->edges[e];
+			if(distances[edge.to] != unreachable || !passable(edge.door, keys, world)) continue;
+			distances[edge.to] = distances[n] + 1;
+			reached.push_back(edge.to);
+		}
+	}
+
+	return;
+}
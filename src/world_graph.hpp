@@ -0,0 +1,108 @@
+#ifndef WORLD_GRAPH_HPP
+#define WORLD_GRAPH_HPP
+
+#include <string>
+#include <vector>
+#include <unordered_map>
+#include <unordered_set>
+
+class Area;
+class Door;
+class Inventory;
+class EntityManager;
+class WorldOverlay;
+
+// The areas and the doors between them form a graph, with areas as the
+// nodes and doors as the edges. The graph is built once the areas have
+// been loaded, and numbers the areas so that routes through the world
+// can be found without comparing area ids.
+//
+// Routes are found using A*, guided by the distances to a handful of
+// landmark areas. If the distances from a landmark to two areas differ by
+// some amount then the areas must be at least that far apart, which gives
+// a lower bound on the distance without searching
+class WorldGraph
+{
+	public:
+
+	// Door leading from an area to the area with node number to
+	class Edge
+	{
+		public:
+
+		unsigned int to;
+		Door* door;
+	};
+
+	// Distance given to areas that can't be reached
+	static const unsigned int unreachable = 0xffffffff;
+
+	private:
+
+	// Areas by node number, and node numbers by area id
+	std::vector<Area*> areas;
+	std::unordered_map<std::string, unsigned int> nodes;
+
+	// The edges leaving node n are edges[edgeStart[n]] up to but not
+	// including edges[edgeStart[n+1]]
+	std::vector<unsigned int> edgeStart;
+	std::vector<Edge> edges;
+
+	// Distance from each landmark to every node, ignoring locks
+	std::vector<std::vector<unsigned int>> landmarkDistances;
+
+	// Lower bound on the number of doors between two nodes
+	unsigned int estimate(unsigned int from, unsigned int to) const;
+
+	public:
+
+	// True if the door can be passed through by someone carrying keys,
+	// which may be nullptr if they have no keys. The lock is read from the
+	// overlay if one is given
+	static bool passable(Door* door, Inventory* keys, WorldOverlay* world = nullptr);
+
+	// Build the graph from every area and door in the entity manager,
+	// and work out the distances to the given number of landmarks
+	void build(EntityManager* mgr, unsigned int numLandmarks = 8);
+
+	// Node number of the area, or -1 if it isn't in the graph
+	int node(const std::string& areaId) const;
+
+	// Area with the given node number
+	Area* area(unsigned int node) const;
+
+	// Number of areas in the graph
+	unsigned int size() const;
+
+	// Edges leaving the node
+	const Edge* edgesBegin(unsigned int node) const;
+	const Edge* edgesEnd(unsigned int node) const;
+
+	// Find the shortest route between two nodes, only going through doors
+	// which are unlocked or that keys can open. If allowed is given then
+	// the route only passes through areas whose ids it contains, and if
+	// world is given the locks are read from it. The doors along the route
+	// are put into path, and false is returned if there's no route
+	bool findPath(unsigned int from, unsigned int to, Inventory* keys,
+		std::vector<Door*>& path,
+		const std::unordered_set<std::string>* allowed = nullptr,
+		WorldOverlay* world = nullptr) const;
+
+	// Fill distances with the number of doors between every node and the
+	// target node, going through doors that keys can open. Handy when lots
+	// of creatures are all heading to the same place. Nodes further away
+	// than maxDistance are left unreachable. Locks are read from the
+	// overlay if one is given
+	void distancesTo(unsigned int target, Inventory* keys, std::vector<unsigned int>& distances,
+		unsigned int maxDistance = unreachable, WorldOverlay* world = nullptr) const;
+
+	// The same, but only the nodes within maxDistance are written, and
+	// they're added to reached. distances must already hold one entry per
+	// node, unreachable everywhere that isn't being written, so a search
+	// over a small part of a large graph can be undone by resetting just
+	// the nodes it reached
+	void distancesTo(unsigned int target, Inventory* keys, std::vector<unsigned int>& distances,
+		unsigned int maxDistance, std::vector<unsigned int>& reached, WorldOverlay* world = nullptr) const;
+};
+
+#endif /* WORLD_GRAPH_HPP */
@@ -0,0 +1,73 @@
+#include <string>
+#include <vector>
+#include <memory>
+#include <unordered_map>
+
+#include "world_overlay.hpp"
+#include "area.hpp"
+#include "door.hpp"
+#include "entity_manager.hpp"
+
+Area* WorldOverlay::getArea(const std::string& id)
+{
+	auto it = this->areas.find(id);
+	if(it != this->areas.end()) return it->second.get();
+
+	return this->mgr->getEntity<Area>(id);
+}
+
+Area* WorldOverlay::editArea(const std::string& id)
+{
+	std::unique_ptr<Area>& area = this->areas[id];
+	if(!area) area.reset(new Area(*this->mgr->getEntity<Area>(id)));
+
+	return area.get();
+}
+
+std::vector<Area*> WorldOverlay::editedAreas()
+{
+	std::vector<Area*> edited;
+	for(auto& area : this->areas)
+	{
+		edited.push_back(area.second.get());
+	}
+
+	return edited;
+}
+
+int WorldOverlay::locked(const Door* door)
+{
+	auto it = this->locks.find(door);
+	if(it != this->locks.end()) return it->second;
+
+	return door->locked;
+}
+
+void WorldOverlay::setLocked(const Door* door, int locked)
+{
+	// No need to remember locks that are the same as the shared one
+	if(locked == door->locked)
+		this->locks.erase(door);
+	else
+		this->locks[door] = locked;
+
+	return;
+}
+
+void WorldOverlay::clear()
+{
+	this->areas.clear();
+	this->locks.clear();
+
+	return;
+}
+
+unsigned int WorldOverlay::size()
+{
+	return this->areas.size();
+}
+
+WorldOverlay::WorldOverlay(EntityManager* mgr)
+{
+	this->mgr = mgr;
+}
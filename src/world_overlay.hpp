@@ -0,0 +1,62 @@
+#ifndef WORLD_OVERLAY_HPP
+#define WORLD_OVERLAY_HPP
+
+#include <string>
+#include <vector>
+#include <memory>
+#include <unordered_map>
+
+class Area;
+class Door;
+class EntityManager;
+
+// The world as one player sees it. The areas and doors loaded into the
+// entity manager are shared between every player and never changed once
+// the game has started. Instead, the first time a player changes an area
+// it's copied into their overlay, and from then on they see and change
+// their copy. Door locks are kept the same way. Memory then only grows
+// with what each player has changed, rather than every player needing
+// their own copy of the whole world
+class WorldOverlay
+{
+	private:
+
+	// Copies of the areas the player has changed, by id
+	std::unordered_map<std::string, std::unique_ptr<Area>> areas;
+
+	// Locks of the doors the player has changed
+	std::unordered_map<const Door*, int> locks;
+
+	public:
+
+	// Shared world the overlay sits on top of
+	EntityManager* mgr;
+
+	// Return the area as the player sees it. It may be shared with other
+	// players, so mustn't be changed
+	Area* getArea(const std::string& id);
+
+	// Return the player's own copy of the area, copying it first if they
+	// don't already have one
+	Area* editArea(const std::string& id);
+
+	// Every area the player has their own copy of
+	std::vector<Area*> editedAreas();
+
+	// Lock of the door as the player sees it
+	int locked(const Door* door);
+
+	// Change the lock of the door for this player only
+	void setLocked(const Door* door, int locked);
+
+	// Forget every change, going back to the shared world
+	void clear();
+
+	// Number of areas copied
+	unsigned int size();
+
+	// Constructor
+	WorldOverlay(EntityManager* mgr);
+};
+
+#endif /* WORLD_OVERLAY_HPP */
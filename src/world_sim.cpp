@@ -0,0 +1,253 @@
+#include <string>
+#include <vector>
+#include <random>
+#include <functional>
+#include <algorithm>
+#include <cstdlib>
+
+#include "world_sim.hpp"
+#include "world_graph.hpp"
+#include "creature.hpp"
+#include "area.hpp"
+#include "world_overlay.hpp"
+#include "trace.hpp"
+
+WorldSim::Move::Move(unsigned int to, const CreatureInstance& creature) : creature(creature)
+{
+	this->to = to;
+}
+
+bool WorldSim::hasMovers(const std::vector<CreatureInstance>& creatures)
+{
+	for(auto& creature : creatures)
+	{
+		if(creature.base->movement != Movement::NONE) return true;
+	}
+
+	return false;
+}
+
+Area* WorldSim::edit(WorldOverlay& world, unsigned int node)
+{
+	if(this->areas[node] == nullptr) this->areas[node] = world.editArea(this->graph->area(node)->id);
+
+	return this->areas[node];
+}
+
+int WorldSim::destination(unsigned int node, CreatureInstance& creature, std::minstd_rand& gen)
+{
+	const WorldGraph::Edge* begin = this->graph->edgesBegin(node);
+	const WorldGraph::Edge* end = this->graph->edgesEnd(node);
+	if(begin == end) return -1;
+
+	// Creatures can't unlock doors, but can go through closed ones
+	switch(creature.base->movement)
+	{
+		case Movement::WANDER:
+		{
+			// Only move half of the time
+			if(gen() % 2 == 0) return -1;
+			const WorldGraph::Edge& edge = begin[gen() % (end - begin)];
+			return WorldGraph::passable(edge.door, nullptr, this->world) ? int(edge.to) : -1;
+		}
+		case Movement::PATROL:
+		{
+			const WorldGraph::Edge& edge = begin[creature.steps++ % (end - begin)];
+			return WorldGraph::passable(edge.door, nullptr, this->world) ? int(edge.to) : -1;
+		}
+		case Movement::CHASE:
+		{
+			// Step to any neighbour closer to the player
+			unsigned int distance = this->chaseDistances[node];
+			if(distance == WorldGraph::unreachable || distance == 0) return -1;
+			for(const WorldGraph::Edge* edge = begin; edge != end; ++edge)
+			{
+				if(this->chaseDistances[edge->to] < distance
+					&& WorldGraph::passable(edge->door, nullptr, this->world))
+					return edge->to;
+			}
+			return -1;
+		}
+		default:
+			return -1;
+	}
+}
+
+unsigned int WorldSim::moveShard(unsigned int shard, unsigned int seed, int playerNode)
+{
+	// Every shard gets its own generator, so they don't have to share one
+	std::minstd_rand gen(seed + shard * 2654435761u);
+	unsigned int moved = 0;
+
+	// Areas left without anything that moves are dropped from the list
+	std::vector<unsigned int>& nodes = this->movers[shard];
+	unsigned int listed = 0;
+	for(unsigned int node : nodes)
+	{
+		Area* area = this->areas[node];
+		if(int(node) == playerNode)
+		{
+			nodes[listed++] = node;
+			continue;
+		}
+
+		// Post the creatures that leave, and move the ones that stay up
+		// to fill the gaps
+		unsigned int kept = 0;
+		for(unsigned int i = 0; i < area->creatures.size(); ++i)
+		{
+			CreatureInstance& creature = area->creatures[i];
+			int to = this->destination(node, creature, gen);
+			if(to < 0)
+			{
+				if(kept != i) area->creatures[kept] = creature;
+				++kept;
+				continue;
+			}
+			this->mailboxes[this->shardOf(to)][shard].push_back(Move(to, creature));
+			++moved;
+		}
+		area->creatures.erase(area->creatures.begin() + kept, area->creatures.end());
+
+		if(hasMovers(area->creatures))
+			nodes[listed++] = node;
+		else
+			this->listed[node] = false;
+	}
+	nodes.resize(listed);
+
+	return moved;
+}
+
+void WorldSim::deliverShard(unsigned int shard)
+{
+	for(auto& mailbox : this->mailboxes[shard])
+	{
+		for(auto& move : mailbox)
+		{
+			this->areas[move.to]->creatures.push_back(move.creature);
+			if(!this->listed[move.to])
+			{
+				this->listed[move.to] = true;
+				this->movers[shard].push_back(move.to);
+			}
+		}
+		mailbox.clear();
+	}
+
+	return;
+}
+
+unsigned int WorldSim::shardOf(unsigned int node)
+{
+	return node / this->shardSize;
+}
+
+unsigned int WorldSim::tick(WorldOverlay& world, const std::string& playerArea)
+{
+	TRACE_SCOPE("WorldSim::tick");
+
+	if(this->graph->size() == 0) return 0;
+
+	// Work out how far every area near the player is from them, for the
+	// chasing creatures. Only the areas that were near them last time
+	// need resetting
+	for(auto node : this->chased) this->chaseDistances[node] = WorldGraph::unreachable;
+	this->chased.clear();
+	int playerNode = this->graph->node(playerArea);
+	if(playerNode >= 0)
+		this->graph->distancesTo(playerNode, nullptr, this->chaseDistances, chaseRange,
+			this->chased, &world);
+
+	// Every area with something that might leave is changed
+	for(auto& nodes : this->movers)
+	{
+		for(auto node : nodes)
+		{
+			if(int(node) != playerNode) this->edit(world, node);
+		}
+	}
+
+	// The seed comes from rand() so that seeding the game seeds this too
+	unsigned int seed = std::rand();
+	std::vector<unsigned int> moved(this->numShards, 0);
+	std::vector<std::function<void()>> batch;
+	for(unsigned int shard = 0; shard < this->numShards; ++shard)
+	{
+		batch.push_back([this, shard, seed, playerNode, &moved]()
+		{
+			moved[shard] = this->moveShard(shard, seed, playerNode);
+		});
+	}
+	this->jobs.run(batch);
+
+	// Every shard has finished posting, so the areas being moved to are
+	// known, and the mailboxes can be emptied into them
+	for(auto& mailboxes : this->mailboxes)
+	{
+		for(auto& mailbox : mailboxes)
+		{
+			for(auto& move : mailbox) this->edit(world, move.to);
+		}
+	}
+	batch.clear();
+	for(unsigned int shard = 0; shard < this->numShards; ++shard)
+	{
+		batch.push_back([this, shard]() { this->deliverShard(shard); });
+	}
+	this->jobs.run(batch);
+
+	unsigned int total = 0;
+	for(auto m : moved) total += m;
+
+	return total;
+}
+
+void WorldSim::reset(WorldOverlay& world)
+{
+	this->world = &world;
+	this->areas.assign(this->graph->size(), nullptr);
+	for(auto& nodes : this->movers) nodes.clear();
+	this->listed.assign(this->graph->size(), false);
+	for(unsigned int node = 0; node < this->graph->size(); ++node)
+	{
+		if(!hasMovers(world.getArea(this->graph->area(node)->id)->creatures)) continue;
+		this->listed[node] = true;
+		this->movers[this->shardOf(node)].push_back(node);
+	}
+
+	return;
+}
+
+void WorldSim::wake(const std::string& area)
+{
+	int node = this->graph->node(area);
+	if(node < 0 || this->listed[node]) return;
+	this->listed[node] = true;
+	this->movers[this->shardOf(node)].push_back(node);
+
+	return;
+}
+
+WorldSim::WorldSim(WorldGraph* graph, unsigned int numShards, unsigned int numThreads) :
+	jobs(numThreads)
+{
+	this->graph = graph;
+
+	// Nodes are numbered in order of area id, so areas with similar ids end
+	// up in the same shard, and most moves stay within a shard
+	unsigned int size = std::max(1u, graph->size());
+	if(numShards == 0) numShards = this->jobs.size() * 4;
+	numShards = std::max(1u, std::min(numShards, size));
+	this->shardSize = (size + numShards - 1) / numShards;
+	this->numShards = (size + this->shardSize - 1) / this->shardSize;
+
+	this->mailboxes.assign(this->numShards,
+		std::vector<std::vector<Move>>(this->numShards));
+
+	this->chaseDistances.assign(graph->size(), WorldGraph::unreachable);
+	this->areas.assign(graph->size(), nullptr);
+	this->world = nullptr;
+	this->movers.assign(this->numShards, std::vector<unsigned int>());
+	this->listed.assign(graph->size(), false);
+}
@@ -0,0 +1,132 @@
+#ifndef WORLD_SIM_HPP
+#define WORLD_SIM_HPP
+
+#include <string>
+#include <vector>
+#include <random>
+
+#include "creature.hpp"
+#include "job_system.hpp"
+
+class WorldGraph;
+class WorldOverlay;
+class Area;
+
+// Moves creatures around the world once per tick, according to their
+// movement type. The world is the one the player sees, so creatures are
+// moved in the player's own copies of the areas and the shared areas are
+// never changed, and doors are locked or unlocked as the player sees
+// them. Only one player can have the world move around them.
+//
+// The areas are split into shards of neighbouring node numbers, and each
+// shard is handled by its own job so that the shards can be processed in
+// parallel.
+//
+// A tick happens in two steps. First every shard decides which of its
+// creatures are leaving and posts them to the mailbox of the shard they're
+// going to. Every shard has a separate mailbox for each sender, so no two
+// jobs ever write to the same place. Then every shard empties its mailboxes
+// into its areas. Nothing needs locking, and creatures can't move twice in
+// one tick.
+//
+// Most areas have no creatures that move by themselves, so each shard keeps
+// a list of the areas that do and only looks at those. Likewise only the
+// areas near enough to the player for chasing creatures to notice them
+// have their distance worked out, and only those are reset next tick
+class WorldSim
+{
+	public:
+
+	// Number of doors away from the player that chasing creatures notice
+	// them from
+	static const unsigned int chaseRange = 8;
+
+	private:
+
+	// A creature on its way to another area
+	class Move
+	{
+		public:
+
+		unsigned int to;
+		CreatureInstance creature;
+
+		Move(unsigned int to, const CreatureInstance& creature);
+	};
+
+	WorldGraph* graph;
+	JobSystem jobs;
+
+	// Number of nodes in each shard, and the number of shards
+	unsigned int shardSize;
+	unsigned int numShards;
+
+	// mailboxes[to][from] holds the creatures shard from is sending to
+	// shard to
+	std::vector<std::vector<std::vector<Move>>> mailboxes;
+
+	// Distance of every area from the player, up to the chase range, and
+	// the areas that were within it
+	std::vector<unsigned int> chaseDistances;
+	std::vector<unsigned int> chased;
+
+	// movers[shard] lists the nodes in the shard holding creatures that
+	// move by themselves, and listed says whether a node is in its list.
+	// Bytes rather than bools, so shards can set their own nodes at once
+	std::vector<std::vector<unsigned int>> movers;
+	std::vector<unsigned char> listed;
+
+	// The player's copy of each area the sim has needed so far, or
+	// nullptr. Copies can't be made whilst the shards are working, since
+	// that changes the overlay, so they're all made before the shards need
+	// them. A copy lasts as long as the overlay, so they're kept until the
+	// sim is reset for another one
+	std::vector<Area*> areas;
+
+	// World the sim was last reset for, whose locks the creatures obey
+	WorldOverlay* world;
+
+	// True if any of the creatures move by themselves
+	static bool hasMovers(const std::vector<CreatureInstance>& creatures);
+
+	// The player's copy of the area in the node, made if needed
+	Area* edit(WorldOverlay& world, unsigned int node);
+
+	// Node the creature in the given node moves to this tick, or -1 if
+	// it stays where it is
+	int destination(unsigned int node, CreatureInstance& creature, std::minstd_rand& gen);
+
+	// Decide where the creatures in the shard go, posting them to the
+	// mailboxes. Creatures in the player's node stay put, since they're
+	// about to fight the player. Returns the number of creatures that moved
+	unsigned int moveShard(unsigned int shard, unsigned int seed, int playerNode);
+
+	// Put the creatures in the shard's mailboxes into their new areas
+	void deliverShard(unsigned int shard);
+
+	public:
+
+	// Shard containing the node
+	unsigned int shardOf(unsigned int node);
+
+	// Move every creature that moves by itself in the world the player
+	// sees, returning how many moved. Chasing creatures head for the area
+	// the player is in. The world must be the one the sim was last reset
+	// for
+	unsigned int tick(WorldOverlay& world, const std::string& playerArea);
+
+	// Start moving creatures in the given world, forgetting the last one.
+	// Called for every new player, including ones just loaded
+	void reset(WorldOverlay& world);
+
+	// Let the sim know creatures have appeared in the area other than by
+	// moving there, such as by respawning
+	void wake(const std::string& area);
+
+	// Create a simulation over the graph, splitting it into the given
+	// number of shards. 0 gives several shards per worker thread, so that
+	// idle workers have shards to steal
+	WorldSim(WorldGraph* graph, unsigned int numShards = 0, unsigned int numThreads = 0);
+};
+
+#endif /* WORLD_SIM_HPP */
@@ -0,0 +1,518 @@
+// Generates a complete set of game content of any size, in the same JSON
+// formats as the files shipped with the game, so that problems that only
+// show up in a big world can be reproduced. Every id that's referred to
+// exists, every area can be reached from area_01 without needing a key,
+// and the key to every locked door can be found somewhere.
+//
+// Output is written a bit at a time as it's generated, and nothing is kept
+// once it's been written, so millions of areas take no more memory than a
+// handful. That means an area has to know about doors leading to it from
+// areas that haven't been written yet, so where each door goes is worked
+// out from a hash of the seed and the door, rather than from a random
+// number generator that would have to be run in order. Everything else is
+// drawn from a generator seeded with the seed, so the same options always
+// give exactly the same files.
+//
+// Usage: world_gen.out [options]
+//   --out DIR          where to write the files (default .)
+//   --seed N           (default 1)
+//   --areas N          number of areas (default 1000)
+//   --items N          number of ordinary items (default 100)
+//   --weapons N        (default 20)
+//   --armor N          (default 20)
+//   --creatures N      kinds of creature (default 20)
+//   --loot N           loot tables (default 10)
+//   --keys N           kinds of key (default 16)
+//   --doors N          doors each area has back to earlier areas (default 2)
+//   --reach N          how far back, in areas, a door can lead (default 16)
+//   --locked F         fraction of doors that are locked (default 0.1)
+//   --stacks N         most stacks of items lying in an area (default 4)
+//   --density F        average number of creatures in an area (default 0.5)
+//   --hordes F         fraction of those that are hordes (default 0.1)
+//   --movers F         fraction of creature kinds that move about (default 0.2)
+#include <iostream>
+#include <fstream>
+#include <string>
+#include <vector>
+#include <random>
+#include <algorithm>
+#include <cstdlib>
+
+#include "../src/json_writer.hpp"
+
+class Options
+{
+	public:
+
+	std::string out;
+	unsigned long long seed;
+	unsigned long long areas;
+	unsigned long long items;
+	unsigned long long weapons;
+	unsigned long long armor;
+	unsigned long long creatures;
+	unsigned long long loot;
+	unsigned long long keys;
+	unsigned long long doors;
+	unsigned long long reach;
+	double locked;
+	unsigned long long stacks;
+	double density;
+	double hordes;
+	double movers;
+
+	Options()
+	{
+		this->out = ".";
+		this->seed = 1;
+		this->areas = 1000;
+		this->items = 100;
+		this->weapons = 20;
+		this->armor = 20;
+		this->creatures = 20;
+		this->loot = 10;
+		this->keys = 16;
+		this->doors = 2;
+		this->reach = 16;
+		this->locked = 0.1;
+		this->stacks = 4;
+		this->density = 0.5;
+		this->hordes = 0.1;
+		this->movers = 0.2;
+	}
+};
+
+Options options;
+
+// Writes a JSON file a piece at a time. The writer keeps track of where it
+// is in the document, so its buffer can be emptied into the file whenever
+// it gets big without losing its place
+class JsonFile
+{
+	private:
+
+	std::ofstream file;
+
+	public:
+
+	JsonWriter json;
+
+	// Write out the buffer if it has grown big enough
+	void flush(bool force = false)
+	{
+		if(force || this->json.buffer.size() > (1 << 20))
+		{
+			this->file << this->json.buffer;
+			this->json.buffer.clear();
+		}
+	}
+
+	JsonFile(const std::string& name)
+	{
+		this->file.open(options.out + "/" + name, std::ios::trunc);
+		if(!this->file)
+		{
+			std::cerr << "Couldn't write " << options.out << "/" << name << std::endl;
+			std::exit(1);
+		}
+		this->json.beginObject();
+	}
+
+	~JsonFile()
+	{
+		this->json.endObject();
+		this->flush(true);
+	}
+};
+
+// Mix the numbers into a hash, from which the same door always gets the
+// same properties
+unsigned long long hash(unsigned long long a, unsigned long long b, unsigned long long salt)
+{
+	unsigned long long x = options.seed * 0x9E3779B97F4A7C15ULL ^ a * 0xBF58476D1CE4E5B9ULL
+		^ b * 0x94D049BB133111EBULL ^ salt;
+	x ^= x >> 30;
+	x *= 0xBF58476D1CE4E5B9ULL;
+	x ^= x >> 27;
+	x *= 0x94D049BB133111EBULL;
+	x ^= x >> 31;
+
+	return x;
+}
+
+// Hash turned into a number from 0 up to but not including 1
+double hashFraction(unsigned long long a, unsigned long long b, unsigned long long salt)
+{
+	return (hash(a, b, salt) >> 11) * (1.0 / 9007199254740992.0);
+}
+
+std::string number(unsigned long long i)
+{
+	std::string s = std::to_string(i);
+	return s.size() < 2 ? "0" + s : s;
+}
+
+// Areas are numbered from 1, so the first is area_01 where players start
+std::string areaId(unsigned long long i)
+{
+	return "area_" + number(i);
+}
+
+// Door s of area i leads back to an earlier area, or doesn't exist if it
+// would lead nowhere or somewhere an earlier door of the area already
+// goes. Door 0 always leads to the area before, and is never locked, so
+// every area can be reached from the first
+unsigned long long doorTarget(unsigned long long i, unsigned long long s)
+{
+	if(i < 2) return 0;
+	if(s == 0) return i - 1;
+
+	unsigned long long back = 1 + hash(i, s, 1) % options.reach;
+	if(back >= i) return 0;
+	unsigned long long target = i - back;
+	for(unsigned long long t = 0; t < s; ++t)
+	{
+		if(doorTarget(i, t) == target) return 0;
+	}
+
+	return target;
+}
+
+bool doorLocked(unsigned long long i, unsigned long long s)
+{
+	return s > 0 && options.keys > 0 && hashFraction(i, s, 2) < options.locked;
+}
+
+unsigned long long doorKey(unsigned long long i, unsigned long long s)
+{
+	return hash(i, s, 3) % options.keys;
+}
+
+std::string doorId(unsigned long long i, unsigned long long s)
+{
+	return "door_" + number(i) + "_" + std::to_string(s);
+}
+
+// Write {"id": [..., ...]} style [id, count] pairs
+void writeStack(JsonWriter& json, const std::string& id, int count)
+{
+	json.beginArray();
+	json.value(id);
+	json.value(count);
+	json.endArray();
+
+	return;
+}
+
+void writeItems()
+{
+	JsonFile file("items.json");
+	for(unsigned long long i = 0; i < options.items; ++i)
+	{
+		file.json.key("item_" + std::to_string(i));
+		file.json.beginObject();
+		file.json.key("name");
+		file.json.value("Item " + std::to_string(i));
+		file.json.key("description");
+		file.json.value("A perfectly ordinary item");
+		file.json.endObject();
+		file.flush();
+	}
+	for(unsigned long long k = 0; k < options.keys; ++k)
+	{
+		file.json.key("item_key_" + std::to_string(k));
+		file.json.beginObject();
+		file.json.key("name");
+		file.json.value("Key " + std::to_string(k));
+		file.json.key("description");
+		file.json.value("A key with a number stamped on it");
+		file.json.endObject();
+	}
+
+	return;
+}
+
+// Weapons and armor only differ in their stat
+void writeEquipment(std::mt19937_64& rng, const std::string& filename,
+	const std::string& prefix, const std::string& stat, unsigned long long n)
+{
+	JsonFile file(filename);
+	for(unsigned long long i = 0; i < n; ++i)
+	{
+		file.json.key(prefix + "_" + std::to_string(i));
+		file.json.beginObject();
+		file.json.key("name");
+		file.json.value(prefix + " " + std::to_string(i));
+		file.json.key(stat);
+		file.json.value(int(1 + rng() % 20));
+		file.json.key("description");
+		file.json.value("");
+		file.json.endObject();
+		file.flush();
+	}
+
+	return;
+}
+
+// A random item, weapon or armor id, of whichever kinds there are any of
+std::string randomItem(std::mt19937_64& rng)
+{
+	unsigned long long total = options.items + options.weapons + options.armor;
+	unsigned long long r = rng() % total;
+	if(r < options.items) return "item_" + std::to_string(r);
+	r -= options.items;
+	if(r < options.weapons) return "weapon_" + std::to_string(r);
+	r -= options.weapons;
+
+	return "armor_" + std::to_string(r);
+}
+
+// Tables can drop items, or roll on tables after them, so they never
+// refer to each other in a loop
+void writeLoot(std::mt19937_64& rng)
+{
+	JsonFile file("loot.json");
+	for(unsigned long long l = 0; l < options.loot; ++l)
+	{
+		file.json.key("loot_" + std::to_string(l));
+		file.json.beginObject();
+		file.json.key("drops");
+		file.json.beginArray();
+		file.json.beginObject();
+		file.json.key("id");
+		file.json.value("nullptr");
+		file.json.key("weight");
+		file.json.value(int(1 + rng() % 10));
+		file.json.endObject();
+		unsigned int numDrops = 1 + rng() % 4;
+		if(options.items + options.weapons + options.armor == 0) numDrops = 0;
+		for(unsigned int d = 0; d < numDrops; ++d)
+		{
+			file.json.beginObject();
+			file.json.key("id");
+			file.json.value(randomItem(rng));
+			file.json.key("weight");
+			file.json.value(int(1 + rng() % 5));
+			file.json.key("min");
+			file.json.value(1);
+			file.json.key("max");
+			file.json.value(int(1 + rng() % 3));
+			file.json.endObject();
+		}
+		if(l + 1 < options.loot && rng() % 4 == 0)
+		{
+			file.json.beginObject();
+			file.json.key("id");
+			file.json.value("loot_" + std::to_string(l + 1 + rng() % (options.loot - l - 1)));
+			file.json.key("weight");
+			file.json.value(1);
+			file.json.endObject();
+		}
+		file.json.endArray();
+		file.json.endObject();
+		file.flush();
+	}
+
+	return;
+}
+
+void writeCreatures(std::mt19937_64& rng)
+{
+	static const char* movements[] = { "wander", "patrol", "chase" };
+
+	JsonFile file("creatures.json");
+	for(unsigned long long c = 0; c < options.creatures; ++c)
+	{
+		// Later creatures are tougher
+		int level = 1 + int(c * 20 / options.creatures);
+		file.json.key("creature_" + std::to_string(c));
+		file.json.beginObject();
+		file.json.key("name");
+		file.json.value("Creature " + std::to_string(c));
+		file.json.key("hp");
+		file.json.value(int(level * 3 + rng() % 5));
+		file.json.key("strength");
+		file.json.value(int(level * 2 + rng() % 5));
+		file.json.key("agility");
+		file.json.value(int(level + rng() % 5));
+		file.json.key("evasion");
+		file.json.value(0.015625 * (1 + rng() % 4));
+		file.json.key("xp");
+		file.json.value(level);
+		if(options.loot > 0)
+		{
+			file.json.key("loot");
+			file.json.value("loot_" + std::to_string(rng() % options.loot));
+		}
+		if(options.weapons > 0)
+		{
+			file.json.key("equipped_weapon");
+			file.json.value("weapon_" + std::to_string(rng() % options.weapons));
+		}
+		if(std::uniform_real_distribution<double>(0, 1)(rng) < options.movers)
+		{
+			file.json.key("movement");
+			file.json.value(movements[rng() % 3]);
+		}
+		file.json.endObject();
+		file.flush();
+	}
+
+	return;
+}
+
+// Areas and their doors are written together, one area at a time
+void writeWorld(std::mt19937_64& rng)
+{
+	JsonFile areas("areas.json");
+	JsonFile doors("doors.json");
+	std::uniform_real_distribution<double> fraction(0, 1);
+
+	for(unsigned long long i = 1; i <= options.areas; ++i)
+	{
+		// Doors from this area back to earlier ones
+		for(unsigned long long s = 0; s < options.doors; ++s)
+		{
+			unsigned long long target = doorTarget(i, s);
+			if(target == 0) continue;
+			doors.json.key(doorId(i, s));
+			doors.json.beginObject();
+			doors.json.key("description");
+			doors.json.value(doorLocked(i, s) ? "iron gate" : "wooden door");
+			doors.json.key("areas");
+			doors.json.beginArray();
+			doors.json.value(areaId(target));
+			doors.json.value(areaId(i));
+			doors.json.endArray();
+			doors.json.key("locked");
+			doors.json.value(doorLocked(i, s) ? 1 : -1);
+			if(doorLocked(i, s))
+			{
+				doors.json.key("key");
+				doors.json.value("item_key_" + std::to_string(doorKey(i, s)));
+			}
+			doors.json.endObject();
+		}
+		doors.flush();
+
+		areas.json.key(areaId(i));
+		areas.json.beginObject();
+		areas.json.key("dialogue");
+		areas.json.beginObject();
+		areas.json.key("description");
+		areas.json.value("You are in area " + std::to_string(i));
+		areas.json.key("choices");
+		areas.json.beginArray();
+		areas.json.endArray();
+		areas.json.endObject();
+
+		// Its own doors, and those from the later areas that lead here
+		areas.json.key("doors");
+		areas.json.beginArray();
+		for(unsigned long long s = 0; s < options.doors; ++s)
+		{
+			if(doorTarget(i, s) != 0) areas.json.value(doorId(i, s));
+		}
+		for(unsigned long long j = i + 1; j <= i + options.reach && j <= options.areas; ++j)
+		{
+			for(unsigned long long s = 0; s < options.doors; ++s)
+			{
+				if(doorTarget(j, s) == i) areas.json.value(doorId(j, s));
+			}
+		}
+		areas.json.endArray();
+
+		// Items lying about. Key k lies in area k + 1, which can always be
+		// reached, so that every locked door can be opened
+		std::vector<std::string> stacks[3];
+		unsigned long long numStacks = options.stacks > 0 ? rng() % (options.stacks + 1) : 0;
+		if(options.items + options.weapons + options.armor == 0) numStacks = 0;
+		for(unsigned long long n = 0; n < numStacks; ++n)
+		{
+			std::string id = randomItem(rng);
+			std::vector<std::string>& kind = stacks[id[0] == 'i' ? 0 : id[0] == 'w' ? 1 : 2];
+			if(std::find(kind.begin(), kind.end(), id) == kind.end()) kind.push_back(id);
+		}
+		for(unsigned long long k = i - 1; k < options.keys; k += options.areas)
+		{
+			stacks[0].push_back("item_key_" + std::to_string(k));
+		}
+		areas.json.key("inventory");
+		areas.json.beginObject();
+		const char* kinds[] = { "items", "weapons", "armor" };
+		for(int kind = 0; kind < 3; ++kind)
+		{
+			areas.json.key(kinds[kind]);
+			areas.json.beginArray();
+			for(auto& id : stacks[kind]) writeStack(areas.json, id, int(1 + rng() % 10));
+			areas.json.endArray();
+		}
+		areas.json.endObject();
+
+		// Creatures, on average density of them, some of which are hordes
+		areas.json.key("creatures");
+		areas.json.beginArray();
+		if(options.creatures > 0)
+		{
+			unsigned int numCreatures = int(options.density);
+			if(fraction(rng) < options.density - numCreatures) ++numCreatures;
+			for(unsigned int n = 0; n < numCreatures; ++n)
+			{
+				std::string id = "creature_" + std::to_string(rng() % options.creatures);
+				if(fraction(rng) < options.hordes)
+					writeStack(areas.json, id, int(5 + rng() % 46));
+				else
+					areas.json.value(id);
+			}
+		}
+		areas.json.endArray();
+		areas.json.endObject();
+		areas.flush();
+	}
+
+	return;
+}
+
+int main(int argc, char* argv[])
+{
+	for(int i = 1; i + 1 < argc; i += 2)
+	{
+		std::string arg = argv[i];
+		std::string value = argv[i+1];
+		if(arg == "--out") options.out = value;
+		else if(arg == "--seed") options.seed = std::strtoull(value.c_str(), nullptr, 10);
+		else if(arg == "--areas") options.areas = std::strtoull(value.c_str(), nullptr, 10);
+		else if(arg == "--items") options.items = std::strtoull(value.c_str(), nullptr, 10);
+		else if(arg == "--weapons") options.weapons = std::strtoull(value.c_str(), nullptr, 10);
+		else if(arg == "--armor") options.armor = std::strtoull(value.c_str(), nullptr, 10);
+		else if(arg == "--creatures") options.creatures = std::strtoull(value.c_str(), nullptr, 10);
+		else if(arg == "--loot") options.loot = std::strtoull(value.c_str(), nullptr, 10);
+		else if(arg == "--keys") options.keys = std::strtoull(value.c_str(), nullptr, 10);
+		else if(arg == "--doors") options.doors = std::strtoull(value.c_str(), nullptr, 10);
+		else if(arg == "--reach") options.reach = std::strtoull(value.c_str(), nullptr, 10);
+		else if(arg == "--locked") options.locked = std::atof(value.c_str());
+		else if(arg == "--stacks") options.stacks = std::strtoull(value.c_str(), nullptr, 10);
+		else if(arg == "--density") options.density = std::atof(value.c_str());
+		else if(arg == "--hordes") options.hordes = std::atof(value.c_str());
+		else if(arg == "--movers") options.movers = std::atof(value.c_str());
+		else
+		{
+			std::cerr << "Unknown option " << arg << std::endl;
+			return 1;
+		}
+	}
+	// The game starts players in area_01, and every area needs a door
+	if(options.areas < 1) options.areas = 1;
+	if(options.doors < 1) options.doors = 1;
+	if(options.reach < 1) options.reach = 1;
+
+	std::mt19937_64 rng(options.seed);
+	writeItems();
+	writeEquipment(rng, "weapons.json", "weapon", "damage", options.weapons);
+	writeEquipment(rng, "armor.json", "armor", "defense", options.armor);
+	writeLoot(rng);
+	writeCreatures(rng);
+	writeWorld(rng);
+
+	return 0;
+}